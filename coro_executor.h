@@ -0,0 +1,264 @@
+/*
+Title: Coroutine Executor with an epoll Reactor
+Name: coro_executor.h
+Author: Ishan Leung
+Language: C++23
+
+Notes:
+Header-only; runs many I/O-bound streams as C++20 coroutines on a few threads.
+- Task<T> is a lazily started coroutine that its awaiter resumes into directly (symmetric
+  transfer); DetachedTask is a top-level coroutine handed to Executor::spawn().
+- co_await executor.readable(fd) parks the coroutine in epoll until the descriptor has data. A
+  parked stream holds only its coroutine frame: no thread, no stack.
+- Worker threads take ready coroutines off a shared queue in batches, and the reactor posts every
+  descriptor one epoll_wait() reports as one batch.
+- Descriptors epoll cannot watch (regular files) are treated as always readable.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+template <typename T>
+class Task;
+
+namespace detail {
+
+struct TaskPromiseBase {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    std::exception_ptr exception;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    // Hand the thread straight to whoever awaited us
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> done) noexcept {
+            return done.promise().continuation;
+        }
+        void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { exception = std::current_exception(); }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+    std::optional<T> value;
+    Task<T> get_return_object();
+    template <typename U>
+    void return_value(U&& result) { value.emplace(std::forward<U>(result)); }
+    T take() {
+        if (exception) std::rethrow_exception(exception);
+        return std::move(*value);
+    }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+    Task<void> get_return_object();
+    void return_void() {}
+    void take() {
+        if (exception) std::rethrow_exception(exception);
+    }
+};
+
+}  // namespace detail
+
+// A coroutine producing a T, started when awaited; owns its frame
+template <typename T = void>
+class [[nodiscard]] Task {
+public:
+    using promise_type = detail::TaskPromise<T>;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+    Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() {
+        if (handle_) handle_.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+        handle_.promise().continuation = awaiter;
+        return handle_;
+    }
+    T await_resume() { return handle_.promise().take(); }
+
+private:
+    std::coroutine_handle<promise_type> handle_;
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+}  // namespace detail
+
+// A top-level coroutine: created suspended, run by Executor::spawn(), frees itself when done
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() { return {std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+    std::coroutine_handle<promise_type> handle;
+};
+
+class Executor {
+public:
+    static constexpr int kBatch = 32;
+
+    explicit Executor(int threads) : epollFd_(epoll_create1(EPOLL_CLOEXEC)), stopFd_(eventfd(0, EFD_CLOEXEC)) {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;  // The stop eventfd
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, stopFd_, &event);
+        reactor_ = std::thread([this] { reactorLoop(); });
+        for (int w = 0; w < std::max(1, threads); ++w) workers_.emplace_back([this] { workerLoop(); });
+    }
+
+    ~Executor() {
+        stop();
+        reactor_.join();
+        for (std::thread& worker : workers_) worker.join();
+        close(epollFd_);
+        close(stopFd_);
+    }
+
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    void spawn(DetachedTask task) { post(&task.handle, 1); }
+
+    // Queue coroutines to be resumed on a worker
+    template <typename Handle>
+    void post(const Handle* handles, size_t count) {
+        if (count == 0) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t k = 0; k < count; ++k) ready_.push_back(handles[k]);
+        }
+        if (count == 1) {
+            wake_.notify_one();
+        } else {
+            wake_.notify_all();
+        }
+    }
+
+    // Ask the workers and reactor to finish; coroutines still parked are abandoned
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        uint64_t one = 1;
+        [[maybe_unused]] ssize_t ignored = write(stopFd_, &one, sizeof(one));
+    }
+
+    // co_await readable(fd): resume on a worker once `fd` has data, hung up or failed
+    auto readable(int fd) { return FdAwaiter{*this, fd, EPOLLIN | EPOLLRDHUP}; }
+
+    // co_await writable(fd): resume on a worker once `fd` can take more data
+    auto writable(int fd) { return FdAwaiter{*this, fd, EPOLLOUT}; }
+
+    // co_await schedule(): continue on a worker, behind whatever is already queued
+    auto schedule() {
+        struct Awaiter {
+            Executor& executor;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) { executor.post(&handle, 1); }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{*this};
+    }
+
+private:
+    // One-shot registration, so a descriptor is watched only while someone waits on it. The
+    // reactor may resume the coroutine before await_suspend returns; nothing touches it after.
+    struct FdAwaiter {
+        Executor& executor;
+        int fd;
+        uint32_t events;
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle) {
+            epoll_event event{};
+            event.events = events | EPOLLONESHOT;
+            event.data.ptr = handle.address();
+            if (epoll_ctl(executor.epollFd_, EPOLL_CTL_MOD, fd, &event) == 0) return true;
+            if (errno == ENOENT && epoll_ctl(executor.epollFd_, EPOLL_CTL_ADD, fd, &event) == 0) return true;
+            return false;  // Not pollable (EPERM for regular files): go straight on
+        }
+        void await_resume() const noexcept {}
+    };
+
+    void workerLoop() {
+        std::coroutine_handle<> batch[kBatch];
+        for (;;) {
+            size_t count = 0;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stopping_ || !ready_.empty(); });
+                if (stopping_) return;
+                while (count < kBatch && !ready_.empty()) {
+                    batch[count++] = ready_.front();
+                    ready_.pop_front();
+                }
+            }
+            for (size_t k = 0; k < count; ++k) batch[k].resume();
+        }
+    }
+
+    void reactorLoop() {
+        epoll_event events[64];
+        std::coroutine_handle<> batch[64];
+        for (;;) {
+            int n = epoll_wait(epollFd_, events, 64, -1);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) return;
+            size_t count = 0;
+            for (int k = 0; k < n; ++k) {
+                if (!events[k].data.ptr) return;  // stop()
+                batch[count++] = std::coroutine_handle<>::from_address(events[k].data.ptr);
+            }
+            post(batch, count);
+        }
+    }
+
+    int epollFd_;
+    int stopFd_;
+    std::thread reactor_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<std::coroutine_handle<>> ready_;
+    bool stopping_ = false;
+};
@@ -5,11 +5,79 @@ Author: Ishan Leung
 Language: C++23
 
 Usage:
-g++ -o freq_analyzer freq_analyzer.cpp -lsndfile -lfftw3
-./freq_analyzer
+g++ -std=c++23 -o freq_analyzer freq_analyzer.cpp fsk_decoder.cpp -lsndfile -lfftw3 -pthread
+./freq_analyzer -f <file.wav> [-f <file2.wav> ...] [--detector fft|goertzel|tone-bank|auto] [--cfar [dB]] [--coarse-to-fine [dB]] [--excise] [--clock-recovery] [--huge-pages] [--mmap] [--report human|json] [--spectrogram <out.png>]
+
+Scaling benchmark (synthetic in-memory corpus, strong and weak scaling at 1, 2, 4 ... N threads):
+./freq_analyzer --bench-scaling [N] [--pin none|compact|scatter]
+
+Unknown symbol rate, plan offset or start (every guess decoded in parallel from one read pass):
+./freq_analyzer -f <file.wav> --hypotheses [--hyp-rates 0.5,1,2] [--hyp-offsets -50,0,50] [--hyp-align 4] [-j N]
+
+Allocation self-test (instrumented build, fails if decoding a chunk allocates after warm-up):
+g++ -std=c++23 -DALLOC_TRACKING -o freq_analyzer_alloc freq_analyzer.cpp fsk_decoder.cpp -lsndfile -lfftw3 -pthread
+./freq_analyzer_alloc --alloc-check [--detector fft|goertzel|tone-bank]
 
 Notes:
-Set path of .wav file in line 72: const char* filename = "Audios/file.wav";
+Decoding itself lives in the fsk_decoder library (fsk_decoder.hpp, or the C ABI in fsk_decoder.h);
+this tool handles files, options and the visual outputs around it.
+Without -f the analyzer opens test_ABC123.wav in the working directory.
+--detector tone-bank decodes with a bank of quadrature mixers and CIC decimators, one per plan tone,
+in integer arithmetic on 16-bit samples, instead of one transform per symbol (fft, the default);
+goertzel computes only the transform bins near plan tones. --detector auto times all three on
+synthetic symbols of each new stream format and keeps the fastest that decodes them correctly,
+caching the choice per host and format in ~/.cache/freq_analyzer/detectors (--detector-cache <file>).
+--cfar [dB] decides each bit against a noise floor tracked per tone (median of the bins within
+tolerance, then over recent symbols) instead of ranking the strongest peaks across the band, so
+off-plan interferers cannot push plan tones out; a tone counts when it stands dB (default 12) above
+its floor. Works with the fft and goertzel detectors.
+--coarse-to-fine [dB] first decides each symbol from a short window in its middle, at the plan tones
+only, and runs the full-length fft or goertzel detector just for symbols where some bit's tones are
+within dB (default 20) of each other there; prints to stderr how many symbols the short window
+decided. Not combined with --cfar.
+--excise masks off-plan bins that carry a line symbol after symbol (mains hum harmonics, a whistle)
+before the fft detector picks the strongest peaks, so a steady interferer cannot displace a plan
+tone; a line is masked from its second symbol on. Not combined with --cfar.
+--clock-recovery estimates, from where the decided tones really fall, how far the recording
+device's sample clock is off the file's nominal rate, and resamples on the fly (cubic Farrow
+interpolator) to cancel it, so long captures from another device keep their symbol boundaries;
+prints the final estimate in ppm to stderr. fft detector only.
+--hypotheses decodes each file under a grid of guesses at unknown stream parameters in one read pass:
+--hyp-rates <symbols/s,...> (default 1), --hyp-offsets <Hz,...> added to every plan tone (default 0),
+and --hyp-align <k> start offsets of 0, 1/k ... (k-1)/k of a symbol. The decoders share the read and
+mix-down and run in parallel on -j threads; each decode is scored by its mean per-bit tone margin
+in dB, the ranking goes to stderr, and the best-scoring decode is printed as usual.
+--huge-pages backs the per-stream scratch arena and the transform plan's twiddles with 2 MiB pages
+(MAP_HUGETLB, else transparent huge pages), and after each file prints to stderr which of them, and
+the --mmap input mapping, really ended up on huge pages.
+--mmap maps 16-bit PCM and float WAV files and decodes the samples in place rather than reading them
+through libsndfile (other formats, and --pipeline, still use libsndfile).
+--spectrogram <out.png|out.ppm|out.pgm> renders an STFT spectrogram during the decode pass (columns in
+parallel on -j threads); with several input files it names a directory and writes <stem>.png each.
+Tune with --spectrogram-width <columns>, --spectrogram-window <samples>, --spectrogram-max-hz <Hz>.
+--pyramid <out.specpyr> writes a tiled multi-resolution spectrogram in the same pass (page-aligned
+256x256 tiles, each level halving time and frequency; --pyramid-pooling max|mean, --pyramid-window,
+--pyramid-tile). --pyramid-view <in.specpyr> <level> <start_s> <end_s> <out.png> renders a viewport
+from only the tiles it covers.
+--waterfall [Hz] replaces the per-chunk dump with a scrolling ANSI-colour view of the 16 plan-tone
+energies and decoded bits, redrawn on its own thread at Hz refreshes per second (default 10).
+--psd [out.csv] surveys a file instead of decoding it: a Welch averaged periodogram over the whole file
+(half-overlapping segments transformed in parallel on -j threads), reporting the strongest spectral
+lines and the median noise floor per band, and writing the PSD as CSV. Tune with --psd-segment
+<samples>, --psd-band <Hz>, --psd-lines <count>.
+--pipeline [spin|futex] decodes in three stages (read, decode, output) on their own threads, linked
+by lock-free SPSC rings; waiting stages busy-poll or sleep on a futex (default). --pin compact|scatter
+pins the stages to their own cores, or --pin-stages <reader>,<decode>,<output> names the CPUs (and
+implies --pipeline). The decoder's buffers and plan are placed on the decode stage's NUMA node, and
+the bench-scaling batch run keeps each file on one node.
+--serve <socket> runs a decode daemon on a Unix domain socket, keeping decoders and plans warm between
+jobs. Connections are coroutines on -j executor threads, so idle or slow clients hold no thread. Jobs
+decode with the detector and options given alongside --serve. Each request line gets one JSON line back:
+  FILE <path> | PCM <s16|f32|f64> <rate> <channels> <bytes> + payload | FD (sound file descriptor
+  passed with SCM_RIGHTS) | FD <s16|f32|f64> <rate> <channels> (raw PCM read to EOF) | STATS
+e.g. echo "FILE $PWD/Audios/test_A.wav" | socat - UNIX-CONNECT:/tmp/fsk.sock
+--report prints peak RSS, bytes allocated by category, page faults and context switches to stderr
+at exit, and per file when several files are given.
 */
 
 #include <iostream>
@@ -18,212 +86,2809 @@ Set path of .wav file in line 72: const char* filename = "Audios/file.wav";
 #include <sndfile.h>
 #include <bitset>
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <latch>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <span>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <pthread.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "coro_executor.h"
+#include "fsk_decoder.hpp"
+#include "resource_usage.h"
+#include "spsc_ring.h"
+
+#ifdef ALLOC_TRACKING
+#include <new>
+
+// Instrumented builds count every global heap allocation so the hot path can be held to zero.
+// The replacements stay out of line: inlined into a delete site, GCC pairs the malloc() it can see
+// with a `delete` and warns about a mismatch that is not there.
+std::atomic<size_t> g_allocCount{0};
+std::atomic<size_t> g_allocBytes{0};
+
+[[gnu::noinline]] void* operator new(std::size_t size) {
+    g_allocCount.fetch_add(1, std::memory_order_relaxed);
+    g_allocBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+[[gnu::noinline]] void* operator new(std::size_t size, std::align_val_t align) {
+    g_allocCount.fetch_add(1, std::memory_order_relaxed);
+    g_allocBytes.fetch_add(size, std::memory_order_relaxed);
+    size_t alignment = std::max(static_cast<size_t>(align), sizeof(void*));
+    if (void* p = std::aligned_alloc(alignment, (std::max<size_t>(size, 1) + alignment - 1) / alignment * alignment)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void* operator new[](std::size_t size, std::align_val_t align) { return operator new(size, align); }
+[[gnu::noinline]] void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete(void* p, std::size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, std::size_t) noexcept { operator delete(p); }
+void operator delete(void* p, std::align_val_t) noexcept { operator delete(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { operator delete(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { operator delete(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { operator delete(p); }
+#endif
+
+// Print one decoded symbol the way the analyzer always has: peaks, per-bit matches, then the byte
+void printSymbol(const FskSymbol& symbol) {
+    std::cout << "\nSamples Read: " << symbol.frames << std::endl;
+
+    // Print detected frequencies for debugging
+    std::cout << "Detected Frequencies: ";
+    for (uint32_t i = 0; i < symbol.num_bits; ++i) {
+        std::cout << symbol.peak_frequency_hz[i] << " Hz, ";
+    }
+    std::cout << std::endl;
 
-#define SAMPLE_RATE 44100  // 44.1 kHz sample rate
-#define CHUNK_SIZE SAMPLE_RATE  // 1 second of audio
-#define MIN_SAMPLES 44000  // Minimum samples threshold for processing
-
-using Complex = std::complex<double>;
-using CArray = std::vector<Complex>;
-
-// Frequency mapping for bit positions
-const std::vector<std::pair<double, double>> bitFrequencyPairs = {
-    {300, 500},   // Bit 1 (LSB)
-    {700, 900},   // Bit 2
-    {1100, 1300}, // Bit 3
-    {1500, 1700}, // Bit 4
-    {1900, 2100}, // Bit 5
-    {2300, 2500}, // Bit 6
-    {2700, 2900}, // Bit 7
-    {3100, 3300}  // Bit 8 (MSB)
-};
-
-// Recursive Cooley-Tukey FFT
-void fft(CArray& data) {
-    int N = data.size();
-    if (N <= 1) return;
-
-    // Divide
-    CArray even(N / 2), odd(N / 2);
-    for (int i = 0; i < N / 2; i++) {
-        even[i] = data[i * 2];
-        odd[i] = data[i * 2 + 1];
-    }
-
-    // Conquer (Recursive call)
-    fft(even);
-    fft(odd);
-
-    // Combine
-    for (int k = 0; k < N / 2; k++) {
-        Complex t = std::polar(1.0, -2 * M_PI * k / N) * odd[k];
-        data[k] = even[k] + t;
-        data[k + N / 2] = even[k] - t;
-    }
-}
-
-// Function to find the 8 most dominant frequencies
-std::vector<double> getTop8Frequencies(const CArray& fftResult, int N, double sampleRate) {
-    std::vector<std::pair<double, int>> magnitudes;
-
-    for (int i = 1; i < N / 2; ++i) {  // Ignore DC component (i=0)
-        double magnitude = std::abs(fftResult[i]);
-        magnitudes.emplace_back(magnitude, i);
-    }
-
-    std::sort(magnitudes.begin(), magnitudes.end(), std::greater<>());  // Sort by magnitude
-
-    std::vector<double> topFrequencies;
-    for (int i = 0; i < 8 && i < magnitudes.size(); ++i) {
-        int peakIndex = magnitudes[i].second;
-        double frequency = (peakIndex * sampleRate) / N;
-        topFrequencies.push_back(frequency);
-    }
-
-    return topFrequencies;
-}
-
-// Function to map detected frequencies to a binary byte with improved output format
-int frequenciesToByte(const std::vector<double>& detectedFrequencies) {
-    int byteValue = 0;
-    std::vector<int> bits(8, 0);
-    std::vector<double> closestFreqs(8, 0.0);
-    
-    // First pass: analyze each bit separately with improved output
-    for (int i = 0; i < 8; ++i) {
-        bool bit0Detected = false;
-        bool bit1Detected = false;
-        double closestFreq = 0.0;
-        double minDiff = 1000.0;  // Initialize with a large value
-        
-        // Find the closest frequency match for this bit position
-        for (double freq : detectedFrequencies) {
-            double diff0 = std::abs(freq - bitFrequencyPairs[i].first);
-            double diff1 = std::abs(freq - bitFrequencyPairs[i].second);
-            
-            if (diff0 < 50 && diff0 < minDiff) {
-                bit0Detected = true;
-                bit1Detected = false;
-                minDiff = diff0;
-                closestFreq = freq;
-            }
-            
-            if (diff1 < 50 && diff1 < minDiff) {
-                bit1Detected = true;
-                bit0Detected = false;
-                minDiff = diff1;
-                closestFreq = freq;
-            }
-        }
-        
-        // Store the bit value and closest frequency
-        bits[i] = bit1Detected ? 1 : 0;
-        closestFreqs[i] = closestFreq;
-    }
-    
     // Display individual bit analysis
-    for (int i = 0; i < 8; ++i) {
+    for (uint32_t i = 0; i < symbol.num_bits; ++i) {
         std::cout << "Bit " << (i + 1) << ": ";
-        if (closestFreqs[i] > 0) {
-            std::cout << closestFreqs[i] << " Hz, ";
+        if (symbol.bit_frequency_hz[i] > 0) {
+            std::cout << symbol.bit_frequency_hz[i] << " Hz, ";
         } else {
             std::cout << "No frequency detected, ";
         }
-        std::cout << bits[i] << std::endl;
-    }
-    
-    // Construct the byte value (MSB first for correct ASCII)
-    for (int i = 0; i < 8; ++i) {
-        if (bits[i]) {
-            // The LSB is bit 0, MSB is bit 7
-            byteValue |= (1 << (7 - i));
-        }
+        std::cout << int(symbol.bits[i]) << std::endl;
     }
-    
-    std::string bitString;
-    for (int i = 0; i < 8; ++i) {
-        bitString += (bits[i] ? '1' : '0');
+
+    char bitString[FSK_MAX_BITS + 1] = {};
+    for (uint32_t i = 0; i < symbol.num_bits; ++i) {
+        bitString[i] = symbol.bits[i] ? '1' : '0';
     }
-    
+
     std::cout << "Decoded Byte: " << bitString;
-    
+
     // Only print ASCII if it's a printable character
-    if (isprint(byteValue)) {
-        std::cout << " (" << char(byteValue) << ")";
+    if (isprint(symbol.value)) {
+        std::cout << " (" << char(symbol.value) << ")";
     }
     std::cout << std::endl;
-    
-    return byteValue;
 }
 
-int main() {
-    const char* filename = "test_ABC123.wav";
-    SNDFILE* file;
-    SF_INFO sfinfo;
+// Charge a decoder's buffers and plan to the resource report
+void accountDecoder(const FskDecoder& decoder) {
+    FskDecoder::Footprint footprint = decoder.footprint();
+    accountAllocation(MemCategory::IoBuffers, footprint.ioBytes);
+    accountAllocation(MemCategory::Spectra, footprint.spectraBytes);
+    accountAllocation(MemCategory::Plans, footprint.planBytes);
+}
 
-    file = sf_open(filename, SFM_READ, &sfinfo);
-    if (!file) {
-        std::cerr << "Failed to open file!" << std::endl;
+// Fill one symbol with the plan tones for `byteValue`, as sine_generator renders them
+void synthesizeByte(std::span<double> out, int byteValue, const DecoderConfig& config) {
+    const int numBits = static_cast<int>(config.tonePairs.size());
+    for (size_t i = 0; i < out.size(); ++i) {
+        double t = static_cast<double>(i) / config.sampleRate;
+        double sample = 0.0;
+        for (int bit = 0; bit < numBits; ++bit) {
+            bool bitValue = (byteValue >> (numBits - 1 - bit)) & 1;
+            double freq = bitValue ? config.tonePairs[bit].second : config.tonePairs[bit].first;
+            sample += std::sin(2.0 * M_PI * freq * t);
+        }
+        out[i] = sample / numBits;
+    }
+}
+
+#ifdef ALLOC_TRACKING
+// Discards everything written to it, so the self-test can silence std::cout without allocating
+struct NullBuffer : std::streambuf {
+    int overflow(int c) override { return c; }
+};
+
+// Self-test for instrumented builds: decode synthetic chunks and fail on any allocation after warm-up
+int runAllocCheck(Detector detector) {
+    const int warmupChunks = 1;
+    const int steadyChunks = 16;
+    DecoderConfig config;
+    config.detector = detector;
+    std::vector<double> samples(config.symbolSamples());
+    int byteValue = -1;
+    FskDecoder decoder(config, [&](const FskSymbol& symbol) {
+        printSymbol(symbol);
+        byteValue = static_cast<int>(symbol.value);
+    });
+
+    NullBuffer nullBuffer;
+    std::streambuf* coutBuffer = std::cout.rdbuf(&nullBuffer);
+
+    size_t steadyAllocs = 0;
+    size_t steadyBytes = 0;
+    int mismatches = 0;
+    for (int chunk = 0; chunk < warmupChunks + steadyChunks; ++chunk) {
+        int expected = (chunk * 37 + 'A') & 0xFF;
+        synthesizeByte(samples, expected, config);
+
+        size_t allocsBefore = g_allocCount.load();
+        size_t bytesBefore = g_allocBytes.load();
+        decoder.push(std::span<const double>(samples));
+        if (chunk >= warmupChunks) {
+            steadyAllocs += g_allocCount.load() - allocsBefore;
+            steadyBytes += g_allocBytes.load() - bytesBefore;
+        }
+        if (byteValue != expected) ++mismatches;
+    }
+
+    std::cout.rdbuf(coutBuffer);
+    std::cout << "Steady-state chunks: " << steadyChunks << ", allocations: " << steadyAllocs
+              << " (" << steadyBytes << " bytes), decode mismatches: " << mismatches << std::endl;
+
+    if (steadyAllocs != 0 || mismatches != 0) {
+        std::cerr << "Allocation check FAILED" << std::endl;
         return 1;
     }
+    std::cout << "Allocation check passed" << std::endl;
+    return 0;
+}
+#endif
 
-    int numChannels = sfinfo.channels;
-    int sampleRate = sfinfo.samplerate;
-    std::vector<double> buffer(CHUNK_SIZE * numChannels);
-    CArray fftInput(CHUNK_SIZE);
+const char* detectorName(Detector detector) {
+    switch (detector) {
+        case Detector::ToneBank: return "tone-bank";
+        case Detector::Goertzel: return "goertzel";
+        default: return "fft";
+    }
+}
 
-    int readSamples;
-    std::vector<char> asciiMessage;
+bool parseDetector(const std::string& name, Detector& detector) {
+    for (Detector candidate : {Detector::Fft, Detector::Goertzel, Detector::ToneBank}) {
+        if (name == detectorName(candidate)) {
+            detector = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Detector autotuning, in the spirit of FFTW's planner. Which engine is fastest depends on the
+// symbol length, the tone plan and the machine, so each engine is timed on synthetic symbols of
+// the stream format at hand and the fastest one that decodes them all correctly wins. Choices are
+// kept per host and format in a cache file (one "<key> <detector>" line each), so a format is
+// measured once per machine rather than once per run.
+class DetectorTuner {
+public:
+    explicit DetectorTuner(std::string cachePath) : cachePath_(std::move(cachePath)) {
+        char host[256] = {};
+        gethostname(host, sizeof(host) - 1);
+        host_ = host;
+        std::ifstream cache(cachePath_);
+        std::string line;
+        while (std::getline(cache, line)) {
+            size_t split = line.rfind(' ');
+            Detector detector;
+            if (split != std::string::npos && parseDetector(line.substr(split + 1), detector)) {
+                choices_[line.substr(0, split)] = detector;
+            }
+        }
+    }
+
+    // $XDG_CACHE_HOME/freq_analyzer/detectors, else under ~/.cache
+    static std::string defaultCachePath() {
+        if (const char* xdg = getenv("XDG_CACHE_HOME"); xdg && *xdg) return std::string(xdg) + "/freq_analyzer/detectors";
+        if (const char* home = getenv("HOME"); home && *home) return std::string(home) + "/.cache/freq_analyzer/detectors";
+        return "freq_analyzer_detectors";
+    }
+
+    // The engine to decode `config`'s format with; measured and cached on first sight of the format
+    Detector choose(const DecoderConfig& config) {
+        std::string key = keyFor(config);
+        if (auto it = choices_.find(key); it != choices_.end()) {
+            if (reported_.insert(key).second) {
+                std::cerr << "Detector: " << detectorName(it->second) << " (cached for this format)" << std::endl;
+            }
+            return it->second;
+        }
+        Detector detector = measure(config);
+        choices_[key] = detector;
+        reported_.insert(key);
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::path(cachePath_).parent_path(), error);
+        std::ofstream cache(cachePath_, std::ios::app);
+        if (cache) cache << key << ' ' << detectorName(detector) << '\n';
+        return detector;
+    }
+
+private:
+    static constexpr int kSymbols = 4;         // Test symbols per pass
+    static constexpr int kMaxPasses = 16;
+    static constexpr double kBudgetSeconds = 0.05;  // Per engine, after the first pass
+
+    // Host plus everything that changes the work per symbol or the engines allowed; channels are
+    // mixed down first
+    std::string keyFor(const DecoderConfig& config) const {
+        std::ostringstream key;
+        key << host_ << ' ' << config.sampleRate << ' ' << config.symbolSamples() << ' ' << config.toleranceHz << ' '
+            << (config.cfar ? "cfar " : "") << (config.coarseToFine ? "coarse " : "")
+            << (config.excision ? "excise " : "") << (config.clockRecovery ? "clock " : "");
+        for (size_t b = 0; b < config.tonePairs.size(); ++b) {
+            key << (b ? "," : "") << config.tonePairs[b].first << ',' << config.tonePairs[b].second;
+        }
+        return key.str();
+    }
+
+    Detector measure(const DecoderConfig& config) {
+        DecoderConfig mono = config;
+        mono.channels = 1;
+        const int n = mono.symbolSamples();
+        const int numBits = static_cast<int>(mono.tonePairs.size());
+
+        // Alternating bit patterns, sent a quarter of the tolerance off frequency so the check
+        // also covers transmitters that are not spot on
+        DecoderConfig transmitter = mono;
+        for (auto& [zero, one] : transmitter.tonePairs) {
+            zero += mono.toleranceHz / 4;
+            one += mono.toleranceHz / 4;
+        }
+        const uint32_t mask = numBits >= 32 ? ~0u : (1u << numBits) - 1;
+        const uint32_t patterns[kSymbols] = {0x5A5A5A5Au & mask, 0xA5A5A5A5u & mask, 0x0F0F0F0Fu & mask, 0xF0F0F0F0u & mask};
+        std::vector<double> samples(size_t(n) * kSymbols);
+        for (int k = 0; k < kSymbols; ++k) {
+            synthesizeByte(std::span<double>(samples).subspan(size_t(k) * n, n), static_cast<int>(patterns[k]), transmitter);
+        }
+
+        std::cerr << "Timing detectors for " << mono.sampleRate << " Hz, " << n << "-sample symbols, " << numBits
+                  << " tone pairs:" << std::endl;
+        Detector best = Detector::Fft;
+        double bestSeconds = std::numeric_limits<double>::infinity();
+        for (Detector engine : {Detector::Fft, Detector::Goertzel, Detector::ToneBank}) {
+            mono.detector = engine;
+            if (mono.validate()) continue;  // Not an option with these settings (e.g. CFAR and the tone bank)
+            std::vector<uint32_t> decoded;
+            FskDecoder decoder(mono, [&](const FskSymbol& symbol) { decoded.push_back(symbol.value); });
+
+            // The first pass is the accuracy check, and a first timing
+            double perSymbol = timePass(decoder, samples);
+            bool accurate = decoded.size() == size_t(kSymbols) && std::equal(decoded.begin(), decoded.end(), patterns);
+            // Only engines still in the running get the full budget
+            double spent = perSymbol * kSymbols;
+            for (int pass = 1; accurate && perSymbol < 2 * bestSeconds && pass < kMaxPasses && spent < kBudgetSeconds; ++pass) {
+                double seconds = timePass(decoder, samples);
+                perSymbol = std::min(perSymbol, seconds);
+                spent += seconds * kSymbols;
+            }
+
+            std::cerr << "  " << std::left << std::setw(10) << detectorName(engine) << std::right << std::fixed
+                      << std::setprecision(1) << perSymbol * 1e6 << " us/symbol" << (accurate ? "" : " (failed accuracy check)")
+                      << std::defaultfloat << std::endl;
+            if (accurate && perSymbol < bestSeconds) {
+                best = engine;
+                bestSeconds = perSymbol;
+            }
+        }
+        std::cerr << "Detector: " << detectorName(best) << std::endl;
+        return best;
+    }
+
+    // Seconds per symbol for one pass over the test symbols
+    static double timePass(FskDecoder& decoder, const std::vector<double>& samples) {
+        auto start = std::chrono::steady_clock::now();
+        decoder.push(std::span<const double>(samples));
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / kSymbols;
+    }
+
+    std::string cachePath_;
+    std::string host_;
+    std::map<std::string, Detector> choices_;
+    std::set<std::string> reported_;  // Formats already announced this run
+};
+
+// CPUs this process may run on, grouped by the NUMA node that owns them. Machines that expose no
+// nodes in sysfs come back as a single group with id -1.
+struct NumaNode {
+    int id;
+    std::vector<int> cpus;
+};
+
+std::vector<NumaNode> numaNodes() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return {};
+
+    std::vector<NumaNode> nodes;
+    for (int node = 0;; ++node) {
+        std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!cpulist) break;
+        std::vector<int> members;
+        std::string range;
+        while (std::getline(cpulist, range, ',')) {
+            int first = 0, last = 0;
+            int fields = sscanf(range.c_str(), "%d-%d", &first, &last);
+            if (fields < 1) continue;
+            if (fields == 1) last = first;
+            for (int cpu = first; cpu <= last; ++cpu) {
+                if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) members.push_back(cpu);
+            }
+        }
+        if (!members.empty()) nodes.push_back({node, std::move(members)});
+    }
+    if (nodes.empty()) {
+        NumaNode all{-1, {}};
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) all.cpus.push_back(cpu);
+        }
+        nodes.push_back(std::move(all));
+    }
+    return nodes;
+}
+
+// NUMA node owning `cpu`, or -1 when unknown
+int cpuNode(int cpu) {
+    if (cpu < 0) return -1;
+    for (const NumaNode& node : numaNodes()) {
+        if (std::find(node.cpus.begin(), node.cpus.end(), cpu) != node.cpus.end()) return node.id;
+    }
+    return -1;
+}
+
+// CPUs this process may run on, ordered for the requested pinning policy.
+// "compact" fills one NUMA node before the next; "scatter" alternates nodes so
+// consecutive threads land on different sockets.
+std::vector<int> pinningOrder(const std::string& policy) {
+    std::vector<NumaNode> nodes = numaNodes();
+    std::vector<int> cpus;
+    for (const NumaNode& node : nodes) cpus.insert(cpus.end(), node.cpus.begin(), node.cpus.end());
+    if (policy != "scatter" || nodes.size() < 2) return cpus;
+
+    // Deal the nodes' CPUs out round-robin
+    std::vector<int> scattered;
+    for (size_t round = 0; scattered.size() < cpus.size(); ++round) {
+        for (const NumaNode& node : nodes) {
+            if (round < node.cpus.size()) scattered.push_back(node.cpus[round]);
+        }
+    }
+    return scattered;
+}
+
+// Pin the calling thread to one CPU; a no-op for negative ids (pinning disabled)
+void pinCurrentThread(int cpu) {
+    if (cpu < 0) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// One in-memory mono recording of one-symbol chunks at the default stream format, with the
+// message it carries
+struct SyntheticFile {
+    std::vector<double> samples;
+    std::string message;
+};
+
+// A decoder that remembers the last byte it produced, for decoding chunks out of order; its
+// buffers and plan live on `numaNode` when one is given
+struct SyntheticDecoder {
+    explicit SyntheticDecoder(int numaNode = -1)
+        : decoder(configFor(numaNode), [this](const FskSymbol& symbol) { lastValue = static_cast<int>(symbol.value); }) {}
+
+    static DecoderConfig configFor(int numaNode) {
+        DecoderConfig config;
+        config.numaNode = numaNode;
+        return config;
+    }
+
+    int lastValue = -1;
+    FskDecoder decoder;
+};
+
+// Decode an in-memory recording chunk by chunk; returns the number of mismatched bytes
+int decodeSynthetic(SyntheticDecoder& worker, const SyntheticFile& file, int firstChunk, int lastChunk) {
+    const size_t chunkSize = worker.decoder.config().symbolSamples();
+    int mismatches = 0;
+    for (int chunk = firstChunk; chunk < lastChunk; ++chunk) {
+        worker.decoder.push(std::span<const double>(file.samples).subspan(chunk * chunkSize, chunkSize));
+        if (worker.lastValue != static_cast<unsigned char>(file.message[chunk])) ++mismatches;
+    }
+    return mismatches;
+}
+
+// Main-memory traffic of one chunk decode, estimated from the buffers each stage streams
+// through: read buffer in, complex copy out, one read+write of the transform per radix stage,
+// the copy back, then the magnitude scan and peak list
+double estimatedChunkTraffic(const FftPlan& plan) {
+    double n = plan.n;
+    double transform = plan.factors.size() * 2.0 * n * sizeof(Complex);
+    return n * sizeof(double) + 2.0 * n * sizeof(Complex) + transform +
+           n * sizeof(Complex) + (n / 2) * (sizeof(Complex) + sizeof(std::pair<double, int>));
+}
+
+struct ScalingRun {
+    int threads;
+    int chunks;
+    double seconds;
+    int mismatches;
+};
+
+// Decode `files` whole, each worker taking the next file (batch parallelism). With pinning, files
+// are dealt to the NUMA nodes the workers run on and each worker drains its own node's share
+// before helping elsewhere, so a file's chunks stay on one node.
+ScalingRun runBatch(const std::vector<SyntheticFile>& corpus, int numFiles, int threads, const std::vector<int>& cpus) {
+    // One cursor per node in use; file f belongs to cursor f % shares
+    std::vector<int> workerNode(threads, -1);
+    std::vector<int> nodeIds;
+    for (int t = 0; t < threads && !cpus.empty(); ++t) {
+        int node = cpuNode(cpus[t % cpus.size()]);
+        auto it = std::find(nodeIds.begin(), nodeIds.end(), node);
+        workerNode[t] = static_cast<int>(it - nodeIds.begin());
+        if (it == nodeIds.end()) nodeIds.push_back(node);
+    }
+    const int shares = std::max<int>(1, nodeIds.size());
+    std::vector<std::atomic<int>> nextInShare(shares);
+
+    std::atomic<int> mismatches{0};
+    std::atomic<int> chunks{0};
+    std::latch ready(threads);
+    std::latch go(1);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            pinCurrentThread(cpus.empty() ? -1 : cpus[t % cpus.size()]);
+            int home = std::max(workerNode[t], 0);
+            SyntheticDecoder worker(nodeIds.empty() ? -1 : nodeIds[home]);
+            ready.count_down();
+            go.wait();
+            for (int step = 0; step < shares; ++step) {
+                int share = (home + step) % shares;
+                for (int k; (k = nextInShare[share].fetch_add(1)) * shares + share < numFiles;) {
+                    const SyntheticFile& file = corpus[(k * shares + share) % corpus.size()];
+                    int numChunks = static_cast<int>(file.message.size());
+                    mismatches += decodeSynthetic(worker, file, 0, numChunks);
+                    chunks += numChunks;
+                }
+            }
+        });
+    }
+    // Time the decoding only: plans, arenas and NUMA placement are built before the clock starts
+    ready.wait();
+    auto start = std::chrono::steady_clock::now();
+    go.count_down();
+    for (std::thread& worker : workers) worker.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return {threads, chunks.load(), seconds, mismatches.load()};
+}
+
+// Decode one file with its chunks shared out across workers (intra-file parallelism)
+ScalingRun runIntraFile(const SyntheticFile& file, int threads, const std::vector<int>& cpus) {
+    const int numChunks = static_cast<int>(file.message.size());
+    std::atomic<int> nextChunk{0};
+    std::atomic<int> mismatches{0};
+    std::latch ready(threads);
+    std::latch go(1);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            int cpu = cpus.empty() ? -1 : cpus[t % cpus.size()];
+            pinCurrentThread(cpu);
+            SyntheticDecoder worker(cpuNode(cpu));
+            ready.count_down();
+            go.wait();
+            for (int c; (c = nextChunk.fetch_add(1)) < numChunks;) {
+                mismatches += decodeSynthetic(worker, file, c, c + 1);
+            }
+        });
+    }
+    ready.wait();
+    auto start = std::chrono::steady_clock::now();
+    go.count_down();
+    for (std::thread& worker : workers) worker.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return {threads, numChunks, seconds, mismatches.load()};
+}
+
+SyntheticFile makeSyntheticFile(int numChunks, unsigned seed) {
+    const DecoderConfig config;
+    const size_t chunkSize = config.symbolSamples();
+    SyntheticFile file;
+    file.samples.resize(numChunks * chunkSize);
+    for (int chunk = 0; chunk < numChunks; ++chunk) {
+        seed = seed * 1103515245u + 12345u;
+        char c = static_cast<char>(' ' + (seed >> 16) % 95);  // Printable ASCII
+        file.message.push_back(c);
+        synthesizeByte(std::span<double>(file.samples).subspan(chunk * chunkSize, chunkSize),
+                       static_cast<unsigned char>(c), config);
+    }
+    return file;
+}
+
+void printScalingTable(const char* title, const std::vector<ScalingRun>& runs, bool weak, double chunkTraffic) {
+    std::cout << "\n" << title << "\n";
+    std::cout << std::left << std::setw(9) << "Threads" << std::setw(8) << "Chunks" << std::setw(11) << "Time (s)"
+              << std::setw(12) << "Chunks/s" << std::setw(9) << "Speedup" << std::setw(12) << "Efficiency"
+              << std::setw(12) << "Input MB/s" << "Est. traffic GB/s" << std::endl;
+    const ScalingRun& base = runs.front();
+    double baseRate = base.chunks / base.seconds;
+    for (const ScalingRun& run : runs) {
+        double rate = run.chunks / run.seconds;
+        // Strong scaling compares time for fixed work; weak scaling compares throughput at fixed work per thread
+        double speedup = weak ? rate / baseRate : base.seconds / run.seconds;
+        double efficiency = speedup / (double(run.threads) / base.threads);
+        double inputMBps = rate * DecoderConfig{}.symbolSamples() * sizeof(int16_t) / 1e6;
+        double trafficGBps = rate * chunkTraffic / 1e9;
+        std::cout << std::left << std::setw(9) << run.threads << std::setw(8) << run.chunks << std::fixed
+                  << std::setprecision(3) << std::setw(11) << run.seconds << std::setprecision(1) << std::setw(12)
+                  << rate << std::setprecision(2) << std::setw(9) << speedup << std::setprecision(1)
+                  << std::setw(12) << efficiency * 100 << std::setw(12) << inputMBps << std::setprecision(2)
+                  << trafficGBps;
+        if (run.mismatches) std::cout << "  (" << run.mismatches << " decode errors)";
+        std::cout << std::defaultfloat << std::endl;
+    }
+}
+
+// Strong and weak scaling of batch and intra-file decode at 1, 2, 4 ... maxThreads workers
+int runScalingBenchmark(int maxThreads, const std::string& pinPolicy) {
+    const int chunksPerFile = 8;
+    const int filesPerThread = 2;
+    std::vector<int> cpus = pinPolicy == "none" ? std::vector<int>{} : pinningOrder(pinPolicy);
+
+    std::vector<int> threadCounts;
+    for (int t = 1; t < maxThreads; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(maxThreads);
+
+    std::cout << "Scaling benchmark: up to " << maxThreads << " threads, pinning " << pinPolicy;
+    if (!cpus.empty()) std::cout << " over " << cpus.size() << " CPUs";
+    std::cout << std::endl;
 
-    while ((readSamples = sf_readf_double(file, buffer.data(), CHUNK_SIZE)) > 0) {
-        if (readSamples < MIN_SAMPLES) continue;  // Skip small chunks
+    // Distinct recordings reused round-robin; larger runs still stream every sample from memory
+    std::vector<SyntheticFile> corpus;
+    for (int f = 0; f < 16; ++f) corpus.push_back(makeSyntheticFile(chunksPerFile, 0x5eed + f));
+    SyntheticFile longFile = makeSyntheticFile(chunksPerFile * filesPerThread * maxThreads, 0x10f6);
+    const size_t chunkSize = DecoderConfig{}.symbolSamples();
+    double chunkTraffic = estimatedChunkTraffic(makeFftPlan(chunkSize));
 
-        std::cout << "\nSamples Read: " << readSamples << std::endl;
+    std::vector<ScalingRun> strongBatch, weakBatch, strongIntra, weakIntra;
+    int strongFiles = filesPerThread * maxThreads;
+    SyntheticFile weakFile;
+    for (int threads : threadCounts) {
+        strongBatch.push_back(runBatch(corpus, strongFiles, threads, cpus));
+        weakBatch.push_back(runBatch(corpus, filesPerThread * threads, threads, cpus));
+        strongIntra.push_back(runIntraFile(longFile, threads, cpus));
+        weakFile.samples.assign(longFile.samples.begin(),
+                                longFile.samples.begin() + chunksPerFile * filesPerThread * threads * chunkSize);
+        weakFile.message = longFile.message.substr(0, chunksPerFile * filesPerThread * threads);
+        weakIntra.push_back(runIntraFile(weakFile, threads, cpus));
+    }
+
+    printScalingTable("Batch decode, strong scaling (fixed corpus)", strongBatch, false, chunkTraffic);
+    printScalingTable("Batch decode, weak scaling (files grow with threads)", weakBatch, true, chunkTraffic);
+    printScalingTable("Intra-file decode, strong scaling (one fixed file)", strongIntra, false, chunkTraffic);
+    printScalingTable("Intra-file decode, weak scaling (file length grows with threads)", weakIntra, true, chunkTraffic);
+    return 0;
+}
+
+// Fixed set of worker threads for data-parallel loops; the calling thread takes part as worker 0
+class ThreadPool {
+public:
+    explicit ThreadPool(int threads) : size_(std::max(1, threads)) {
+        for (int w = 1; w < size_; ++w) {
+            workers_.emplace_back([this, w] { workerLoop(w); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread& worker : workers_) worker.join();
+    }
+
+    int size() const { return size_; }
+
+    // Run fn(index, worker) for every index in [0, count) and wait for all of them
+    void parallelFor(int count, const std::function<void(int, int)>& fn) {
+        if (count <= 0) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job_ = &fn;
+            jobCount_ = count;
+            next_ = 0;
+            active_ = size_ - 1;
+            ++generation_;
+        }
+        wake_.notify_all();
+        runJob(fn, count, 0);
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return active_ == 0; });
+        job_ = nullptr;
+    }
+
+private:
+    void runJob(const std::function<void(int, int)>& fn, int count, int worker) {
+        for (int i; (i = next_.fetch_add(1)) < count;) fn(i, worker);
+    }
+
+    void workerLoop(int worker) {
+        uint64_t seen = 0;
+        for (;;) {
+            const std::function<void(int, int)>* job;
+            int count;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+                if (stopping_) return;
+                seen = generation_;
+                job = job_;
+                count = jobCount_;
+            }
+            runJob(*job, count, worker);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--active_ == 0) done_.notify_one();
+        }
+    }
+
+    int size_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(int, int)>* job_ = nullptr;
+    int jobCount_ = 0;
+    std::atomic<int> next_{0};
+    int active_ = 0;
+    uint64_t generation_ = 0;
+    bool stopping_ = false;
+};
+
+// Streams an 8-bit grey or RGB image to PNG, PGM or PPM one row at a time.
+// PNG data goes out as stored (uncompressed) deflate blocks, so no zlib is needed
+// and memory stays at one block regardless of image size.
+class ImageRowWriter {
+public:
+    bool open(const std::string& path, int width, int height, int channels) {
+        width_ = width;
+        channels_ = channels;
+        png_ = path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0;
+        out_.open(path, std::ios::binary);
+        if (!out_) return false;
+
+        if (!png_) {
+            out_ << (channels == 1 ? "P5\n" : "P6\n") << width << " " << height << "\n255\n";
+            return bool(out_);
+        }
+
+        static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        out_.write(reinterpret_cast<const char*>(signature), 8);
+        unsigned char ihdr[13];
+        putBigEndian(ihdr, width);
+        putBigEndian(ihdr + 4, height);
+        ihdr[8] = 8;                         // Bit depth
+        ihdr[9] = channels == 1 ? 0 : 2;     // Greyscale or truecolour
+        ihdr[10] = ihdr[11] = ihdr[12] = 0;  // Deflate, adaptive filtering, no interlace
+        writeChunk("IHDR", ihdr, sizeof(ihdr));
+
+        pending_.assign({0x78, 0x01});  // zlib header: deflate, 32K window, no preset dictionary
+        return bool(out_);
+    }
+
+    void writeRow(std::span<const uint8_t> row) {
+        if (!png_) {
+            out_.write(reinterpret_cast<const char*>(row.data()), row.size());
+            return;
+        }
+        appendRaw(0);  // Filter type: none
+        for (uint8_t value : row) appendRaw(value);
+    }
+
+    bool finish() {
+        if (png_) {
+            flushStored(true);
+            unsigned char adler[4];
+            putBigEndian(adler, (adlerB_ << 16) | adlerA_);
+            pending_.insert(pending_.end(), adler, adler + 4);
+            writeChunk("IDAT", pending_.data(), pending_.size());
+            writeChunk("IEND", nullptr, 0);
+        }
+        out_.close();
+        return !out_.fail();
+    }
+
+private:
+    static constexpr size_t kMaxStored = 65535;
+
+    static void putBigEndian(unsigned char* p, uint32_t v) {
+        p[0] = v >> 24;
+        p[1] = v >> 16;
+        p[2] = v >> 8;
+        p[3] = v;
+    }
+
+    static uint32_t crc32(uint32_t crc, const unsigned char* data, size_t size) {
+        static const auto table = [] {
+            std::array<uint32_t, 256> t{};
+            for (uint32_t n = 0; n < 256; ++n) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                t[n] = c;
+            }
+            return t;
+        }();
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    void writeChunk(const char* type, const unsigned char* data, size_t size) {
+        unsigned char header[8];
+        putBigEndian(header, static_cast<uint32_t>(size));
+        memcpy(header + 4, type, 4);
+        uint32_t crc = crc32(crc32(0, header + 4, 4), data, size);
+        unsigned char trailer[4];
+        putBigEndian(trailer, crc);
+        out_.write(reinterpret_cast<const char*>(header), 8);
+        if (size) out_.write(reinterpret_cast<const char*>(data), size);
+        out_.write(reinterpret_cast<const char*>(trailer), 4);
+    }
+
+    void appendRaw(uint8_t value) {
+        adlerA_ = (adlerA_ + value) % 65521;
+        adlerB_ = (adlerB_ + adlerA_) % 65521;
+        block_.push_back(value);
+        if (block_.size() == kMaxStored) flushStored(false);
+    }
+
+    // Wrap the buffered raw bytes in one stored deflate block and emit it as an IDAT chunk
+    void flushStored(bool final) {
+        uint16_t len = static_cast<uint16_t>(block_.size());
+        pending_.push_back(final ? 1 : 0);
+        pending_.push_back(len & 0xFF);
+        pending_.push_back(len >> 8);
+        pending_.push_back(~len & 0xFF);
+        pending_.push_back((~len >> 8) & 0xFF);
+        pending_.insert(pending_.end(), block_.begin(), block_.end());
+        block_.clear();
+        if (!final) {
+            writeChunk("IDAT", pending_.data(), pending_.size());
+            pending_.clear();
+        }
+    }
+
+    std::ofstream out_;
+    bool png_ = false;
+    int width_ = 0;
+    int channels_ = 1;
+    std::vector<unsigned char> pending_;
+    std::vector<unsigned char> block_;
+    uint32_t adlerA_ = 1;
+    uint32_t adlerB_ = 0;
+};
+
+// Power-to-8-bit-dB table indexed by a float's exponent and top mantissa bits: integer-only,
+// branch-free and vectorizable, with no log10 per pixel
+class DbLevelLut {
+public:
+    // `reference` is the power mapped to 0 dB (level 255), `floorDb` the level mapped to 0
+    void build(double reference, double floorDb) {
+        table_.resize(size_t(1) << (32 - kShift));
+        for (uint32_t index = 0; index < table_.size(); ++index) {
+            float power = std::bit_cast<float>((index << kShift) | (1u << (kShift - 1)));
+            double db = 10.0 * std::log10(std::max<double>(power, 1e-30) / reference);
+            double level = (db - floorDb) / -floorDb * 255.0;
+            table_[index] = std::isfinite(power) && power >= 0 ? static_cast<uint8_t>(std::clamp(level, 0.0, 255.0)) : 0;
+        }
+    }
+
+    uint8_t operator()(float power) const { return table_[std::bit_cast<uint32_t>(power) >> kShift]; }
+
+    void map(std::span<const float> powers, uint8_t* out) const {
+        for (size_t i = 0; i < powers.size(); ++i) out[i] = table_[std::bit_cast<uint32_t>(powers[i]) >> kShift];
+    }
+
+private:
+    static constexpr int kShift = 18;  // Keeps 5 mantissa bits: 0.2 dB steps
+    std::vector<uint8_t> table_;
+};
+
+// Sliding Hann-windowed STFT over pushed samples. Columns are transformed in parallel as soon as
+// their window is complete and handed on in order, in batches; samples no later column needs are
+// dropped, so memory stays at about one window plus one read chunk.
+class StftStream {
+public:
+    // Power spectra of columns [first, first + count), `bins` floats each
+    using BatchSink = std::function<void(int64_t first, int64_t count, std::span<const float> powers)>;
+
+    StftStream(int windowSize, int bins, int64_t numColumns, std::function<int64_t(int64_t)> columnStart,
+               ThreadPool& pool)
+        : windowSize_(windowSize), bins_(bins), numColumns_(numColumns), columnStart_(std::move(columnStart)),
+          pool_(pool), plan_(makeFftPlan(windowSize)) {
+        window_.resize(windowSize);
+        for (int i = 0; i < windowSize; ++i) window_[i] = 0.5 - 0.5 * std::cos(2 * M_PI * i / windowSize);
+
+        scratch_.resize(pool.size());
+        for (CArray& s : scratch_) s.resize(windowSize + plan_.scratchSize());
+        accountAllocation(MemCategory::Plans, plan_.bytes());
+        accountAllocation(MemCategory::Spectra, scratch_.size() * (windowSize + plan_.scratchSize()) * sizeof(Complex) +
+                                                    size_t(kMaxBatch) * bins * sizeof(float));
+    }
+
+    // Power a full-scale sine reaches in its peak bin: a Hann window gives |X| = n / 4
+    double fullScalePower() const { return (windowSize_ / 4.0) * (windowSize_ / 4.0); }
+
+    // Append interleaved samples and emit every column that is now complete
+    void push(std::span<const double> interleaved, int numChannels, const BatchSink& sink) {
+        size_t frames = interleaved.size() / numChannels;
+        for (size_t i = 0; i < frames; ++i) {
+            double sum = 0;
+            for (int ch = 0; ch < numChannels; ++ch) sum += interleaved[i * numChannels + ch];
+            pending_.push_back(static_cast<float>(sum / numChannels));
+        }
+        emitReadyColumns(false, sink);
+    }
+
+    // Emit the remaining columns, zero-padded past the end of the input
+    void finish(const BatchSink& sink) { emitReadyColumns(true, sink); }
+
+private:
+    static constexpr int kMaxBatch = 256;
+
+    void emitReadyColumns(bool flush, const BatchSink& sink) {
+        int64_t available = pendingStart_ + static_cast<int64_t>(pending_.size());
+        while (nextColumn_ < numColumns_) {
+            int64_t end = nextColumn_;
+            while (end < numColumns_ && end - nextColumn_ < kMaxBatch &&
+                   (flush || columnStart_(end) + windowSize_ <= available)) {
+                ++end;
+            }
+            if (end == nextColumn_) break;
+
+            int64_t first = nextColumn_;
+            powers_.resize(size_t(end - first) * bins_);
+            pool_.parallelFor(static_cast<int>(end - first), [&](int index, int worker) {
+                transformColumn(first + index, scratch_[worker], &powers_[size_t(index) * bins_]);
+            });
+            nextColumn_ = end;
+            sink(first, end - first, powers_);
+        }
+
+        // Drop samples no later column can reach
+        int64_t keepFrom = nextColumn_ < numColumns_ ? columnStart_(nextColumn_) : available;
+        int64_t drop = std::clamp<int64_t>(keepFrom - pendingStart_, 0, pending_.size());
+        pending_.erase(pending_.begin(), pending_.begin() + drop);
+        pendingStart_ += drop;
+    }
+
+    void transformColumn(int64_t c, CArray& scratch, float* powers) {
+        std::span<Complex> frame(scratch.data(), windowSize_);
+        int64_t start = columnStart_(c);
+        for (int i = 0; i < windowSize_; ++i) {
+            int64_t index = start + i - pendingStart_;
+            double sample = index >= 0 && index < static_cast<int64_t>(pending_.size()) ? pending_[index] : 0.0;
+            frame[i] = Complex(sample * window_[i], 0.0);
+        }
+        fft(plan_, frame, std::span<Complex>(scratch).subspan(windowSize_));
+        for (int bin = 0; bin < bins_; ++bin) powers[bin] = static_cast<float>(std::norm(frame[bin]));
+    }
+
+    int windowSize_;
+    int bins_;
+    int64_t numColumns_;
+    std::function<int64_t(int64_t)> columnStart_;  // First sample of a column's window
+    ThreadPool& pool_;
+    FftPlan plan_;
+    std::vector<double> window_;
+    std::vector<CArray> scratch_;  // One transform work area per pool worker
+    std::vector<float> powers_;    // Current batch, column-major
+    std::vector<float> pending_;   // Mono samples not yet consumed by every column
+    int64_t pendingStart_ = 0;     // Absolute index of pending_[0]
+    int64_t nextColumn_ = 0;
+};
+
+struct SpectrogramOptions {
+    std::string path;       // .png, .ppm or .pgm; a directory when batch-decoding several files
+    int width = 1000;       // Time columns
+    int windowSize = 4096;  // STFT length in samples
+    double maxHz = 4000;    // Top of the frequency axis
+    double floorDb = -120;  // Level mapped to black
+};
 
-        std::fill(buffer.begin() + readSamples, buffer.end(), 0);  // Zero-pad small chunks
+// Spectrogram image fed from the decoder's read loop, so decoding and rendering share one pass
+// over the file. Each column is kept as 8-bit levels and the image is streamed out row by row.
+class SpectrogramRenderer {
+public:
+    SpectrogramRenderer(const SpectrogramOptions& options, int sampleRate, int64_t totalFrames, ThreadPool& pool)
+        : options_(options),
+          totalFrames_(std::max<int64_t>(totalFrames, 1)),
+          width_(static_cast<int>(std::clamp<int64_t>(options.width, 1, totalFrames_))),
+          height_(std::clamp(static_cast<int>(options.maxHz * options.windowSize / sampleRate) + 1, 1,
+                             options.windowSize / 2 + 1)),
+          stft_(options.windowSize, height_, width_, [this](int64_t c) { return columnStart(c); }, pool) {
+        levels_.resize(size_t(width_) * height_);
+        accountAllocation(MemCategory::Spectra, levels_.size());
+        lut_.build(stft_.fullScalePower(), options.floorDb);
+        buildColormap();
+    }
+
+    void push(std::span<const double> interleaved, int numChannels) {
+        stft_.push(interleaved, numChannels, [this](int64_t first, int64_t count, std::span<const float> powers) {
+            lut_.map(powers.first(size_t(count) * height_), &levels_[size_t(first) * height_]);
+        });
+    }
+
+    // Render the remaining (zero-padded) columns and write the image
+    bool finish() {
+        stft_.finish([this](int64_t first, int64_t count, std::span<const float> powers) {
+            lut_.map(powers.first(size_t(count) * height_), &levels_[size_t(first) * height_]);
+        });
 
-        // Convert stereo to mono if needed
-        if (numChannels > 1) {
-            for (int i = 0; i < readSamples; ++i) {
-                buffer[i] = 0;
-                for (int ch = 0; ch < numChannels; ++ch) {
-                    buffer[i] += buffer[i * numChannels + ch];
+        ImageRowWriter writer;
+        bool grey = options_.path.ends_with(".pgm");
+        if (!writer.open(options_.path, width_, height_, grey ? 1 : 3)) return false;
+        std::vector<uint8_t> row(size_t(width_) * (grey ? 1 : 3));
+        for (int y = 0; y < height_; ++y) {
+            int bin = height_ - 1 - y;  // Highest frequency on top
+            for (int x = 0; x < width_; ++x) {
+                uint8_t level = levels_[size_t(x) * height_ + bin];
+                if (grey) {
+                    row[x] = level;
+                } else {
+                    memcpy(&row[size_t(x) * 3], colormap_[level].data(), 3);
                 }
-                buffer[i] /= numChannels;
             }
+            writer.writeRow(row);
         }
+        return writer.finish();
+    }
+
+private:
+    // Columns are spread evenly over the file and centred on their slot
+    int64_t columnStart(int64_t c) const {
+        return c * totalFrames_ / width_ + totalFrames_ / (2 * width_) - options_.windowSize / 2;
+    }
 
-        // Convert real input to complex format for FFT
-        for (int i = 0; i < CHUNK_SIZE; i++) {
-            fftInput[i] = Complex(buffer[i], 0.0);
+    // Black through purple, red and yellow to white, like the SoX renders in Spectrograms/
+    void buildColormap() {
+        const std::array<std::pair<double, std::array<double, 3>>, 7> anchors = {{
+            {0.00, {0, 0, 0}}, {0.20, {40, 0, 90}}, {0.40, {140, 0, 140}}, {0.60, {220, 30, 50}},
+            {0.80, {255, 160, 0}}, {0.93, {255, 240, 80}}, {1.00, {255, 255, 255}},
+        }};
+        for (int level = 0; level < 256; ++level) {
+            double x = level / 255.0;
+            size_t k = 1;
+            while (k + 1 < anchors.size() && anchors[k].first < x) ++k;
+            double t = (x - anchors[k - 1].first) / (anchors[k].first - anchors[k - 1].first);
+            for (int ch = 0; ch < 3; ++ch) {
+                double v = anchors[k - 1].second[ch] + t * (anchors[k].second[ch] - anchors[k - 1].second[ch]);
+                colormap_[level][ch] = static_cast<uint8_t>(std::clamp(v, 0.0, 255.0));
+            }
         }
+    }
+
+    SpectrogramOptions options_;
+    int64_t totalFrames_;
+    int width_;
+    int height_;
+    StftStream stft_;
+    std::vector<uint8_t> levels_;  // Column-major 8-bit levels, height_ per column
+    DbLevelLut lut_;
+    std::array<std::array<uint8_t, 3>, 256> colormap_{};
+};
+
+// Output path for one input file: the option itself, or <dir>/<stem><extension> when it names a directory
+std::string outputPathFor(const std::string& option, const char* filename, bool batch, const char* extension) {
+    std::filesystem::path out(option);
+    if (batch || option.ends_with('/') || std::filesystem::is_directory(out)) {
+        return (out / std::filesystem::path(filename).stem()).string() + extension;
+    }
+    return option;
+}
+
+struct PyramidOptions {
+    std::string path;
+    int windowSize = 1024;  // STFT length; level 0 hops by half a window
+    int tileSize = 256;     // Tiles are tileSize x tileSize bytes, a whole number of pages
+    bool meanPooling = false;
+    double floorDb = -120;
+};
 
-        fft(fftInput);  // Perform FFT
+// On-disk layout of a spectrogram pyramid (.specpyr), little-endian. The header and level table
+// sit in the first page; every level starts page-aligned and is an array of fixed-size tiles,
+// row-major by (tileY, tileX), each tile row-major with row 0 at the lowest frequency. A viewport
+// at any level is rendered by mapping the file and touching only the tiles it covers.
+struct PyramidHeader {
+    char magic[8] = {'S', 'P', 'E', 'C', 'P', 'Y', 'R', '1'};
+    uint32_t sampleRate = 0;
+    uint32_t windowSize = 0;
+    uint32_t hop = 0;          // Samples between level-0 columns
+    uint32_t tileSize = 0;
+    uint32_t numLevels = 0;
+    uint32_t meanPooling = 0;  // 0 = max pooled, 1 = mean pooled (in power)
+    float floorDb = 0;         // Tile byte 0 is this level; 255 is 0 dBFS
+    uint32_t reserved = 0;
+};
+
+struct PyramidLevel {
+    uint64_t columns;  // Time columns at this level; each level halves time and frequency
+    uint32_t rows;     // Frequency rows, 0 Hz .. sampleRate / 2
+    uint32_t tilesX;
+    uint32_t tilesY;
+    uint32_t reserved;
+    uint64_t offset;   // File offset of tile (0, 0)
+};
+
+constexpr size_t kPyramidPage = 4096;
+constexpr int kMaxPyramidLevels = 32;
 
-        std::vector<double> detectedFrequencies = getTop8Frequencies(fftInput, CHUNK_SIZE, sampleRate);
+// Builds the pyramid in the decoder's single read pass. Each level holds one strip of tileSize
+// columns plus one column awaiting its pooling partner, so memory is bounded by the tile size and
+// number of levels, not the recording length; finished strips are written in place with pwrite.
+class SpectrogramPyramid {
+public:
+    SpectrogramPyramid(const PyramidOptions& options, int sampleRate, int64_t totalFrames, ThreadPool& pool)
+        : options_(options),
+          tile_(options.tileSize),
+          bins_(options.windowSize / 2 + 1),
+          stft_(options.windowSize, bins_, std::max<int64_t>(1, (totalFrames + hop() - 1) / hop()),
+                [this](int64_t c) { return c * hop() - options_.windowSize / 2; }, pool) {
+        header_.sampleRate = sampleRate;
+        header_.windowSize = options.windowSize;
+        header_.hop = hop();
+        header_.tileSize = tile_;
+        header_.meanPooling = options.meanPooling;
+        header_.floorDb = static_cast<float>(options.floorDb);
 
-        // Print detected frequencies for debugging
-        std::cout << "Detected Frequencies: ";
-        for (double freq : detectedFrequencies) {
-            std::cout << freq << " Hz, ";
+        // Halve both axes until a level fits in one tile
+        uint64_t columns = std::max<int64_t>(1, (totalFrames + hop() - 1) / hop());
+        uint32_t rows = bins_;
+        uint64_t offset = kPyramidPage;
+        for (;;) {
+            PyramidLevel level{};
+            level.columns = columns;
+            level.rows = rows;
+            level.tilesX = static_cast<uint32_t>((columns + tile_ - 1) / tile_);
+            level.tilesY = (rows + tile_ - 1) / tile_;
+            level.offset = offset;
+            offset += roundUpPage(uint64_t(level.tilesX) * level.tilesY * tileBytes());
+            levels_.push_back(level);
+            if ((columns <= uint64_t(tile_) && rows <= uint32_t(tile_)) || levels_.size() == kMaxPyramidLevels) break;
+            columns = (columns + 1) / 2;
+            rows = (rows + 1) / 2;
         }
-        std::cout << std::endl;
+        header_.numLevels = static_cast<uint32_t>(levels_.size());
+        fileSize_ = offset;
 
-        int byteValue = frequenciesToByte(detectedFrequencies);
-        asciiMessage.push_back(static_cast<char>(byteValue));
+        state_.resize(levels_.size());
+        for (size_t l = 0; l < levels_.size(); ++l) {
+            state_[l].strip.assign(size_t(tile_) * levels_[l].rows, 0.0f);
+            accountAllocation(MemCategory::Spectra, state_[l].strip.size() * sizeof(float) * 2);
+        }
+        tileBuffer_.resize(tileBytes());
+        lut_.build(stft_.fullScalePower(), options.floorDb);
     }
 
-    sf_close(file);
+    ~SpectrogramPyramid() {
+        if (fd_ >= 0) close(fd_);
+    }
 
-    std::cout << "\nDecoded Message: ";
-    for (char c : asciiMessage) {
-        if (isprint(c)) {
-            std::cout << c;
+    bool open() {
+        fd_ = ::open(options_.path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0 || ftruncate(fd_, static_cast<off_t>(fileSize_)) != 0) return false;
+        std::vector<unsigned char> page(kPyramidPage, 0);
+        memcpy(page.data(), &header_, sizeof(header_));
+        memcpy(page.data() + sizeof(header_), levels_.data(), levels_.size() * sizeof(PyramidLevel));
+        return writeAt(page.data(), page.size(), 0);
+    }
+
+    void push(std::span<const double> interleaved, int numChannels) {
+        stft_.push(interleaved, numChannels, [this](int64_t, int64_t count, std::span<const float> powers) {
+            for (int64_t c = 0; c < count; ++c) addColumn(0, powers.subspan(size_t(c) * bins_, bins_));
+        });
+    }
+
+    // Flush the last columns and partial strips of every level; returns false on a write error
+    bool finish() {
+        stft_.finish([this](int64_t, int64_t count, std::span<const float> powers) {
+            for (int64_t c = 0; c < count; ++c) addColumn(0, powers.subspan(size_t(c) * bins_, bins_));
+        });
+        for (size_t l = 0; l < levels_.size(); ++l) {
+            LevelState& state = state_[l];
+            // An unpaired last column is pooled on its own
+            if (state.hasCarry && l + 1 < levels_.size()) {
+                state.hasCarry = false;
+                addColumn(l + 1, poolColumns(l, state.carry, state.carry));
+            }
+            if (state.filled > 0) flushStrip(l);
+        }
+        bool ok = ok_ && fsync(fd_) == 0;
+        close(fd_);
+        fd_ = -1;
+        return ok;
+    }
+
+    uint64_t fileSize() const { return fileSize_; }
+    size_t numLevels() const { return levels_.size(); }
+
+private:
+    struct LevelState {
+        std::vector<float> strip;  // tileSize columns, column-major
+        int filled = 0;
+        uint64_t stripIndex = 0;   // Tile column the strip belongs to
+        std::vector<float> carry;  // Column waiting for its pooling partner
+        bool hasCarry = false;
+        std::vector<float> pooled;
+    };
+
+    int hop() const { return std::max(1, options_.windowSize / 2); }
+    size_t tileBytes() const { return size_t(tile_) * tile_; }
+    static uint64_t roundUpPage(uint64_t bytes) { return (bytes + kPyramidPage - 1) / kPyramidPage * kPyramidPage; }
+
+    void addColumn(size_t l, std::span<const float> column) {
+        LevelState& state = state_[l];
+        std::copy(column.begin(), column.end(), state.strip.begin() + size_t(state.filled) * levels_[l].rows);
+        if (++state.filled == tile_) flushStrip(l);
+
+        if (l + 1 == levels_.size()) return;
+        if (!state.hasCarry) {
+            state.carry.assign(column.begin(), column.end());
+            state.hasCarry = true;
         } else {
-            std::cout << "?"; // Replace non-printable characters
+            state.hasCarry = false;
+            addColumn(l + 1, poolColumns(l, state.carry, column));
         }
     }
-    std::cout << std::endl;
 
-    return 0;
-}
\ No newline at end of file
+    // 2x2 pooling of two adjacent columns of level l into one column of level l + 1
+    std::span<const float> poolColumns(size_t l, std::span<const float> a, std::span<const float> b) {
+        LevelState& state = state_[l];
+        uint32_t rows = levels_[l].rows;
+        state.pooled.resize(levels_[l + 1].rows);
+        for (uint32_t r = 0; r < levels_[l + 1].rows; ++r) {
+            uint32_t r1 = std::min(2 * r + 1, rows - 1);
+            if (options_.meanPooling) {
+                state.pooled[r] = 0.25f * (a[2 * r] + a[r1] + b[2 * r] + b[r1]);
+            } else {
+                state.pooled[r] = std::max({a[2 * r], a[r1], b[2 * r], b[r1]});
+            }
+        }
+        return state.pooled;
+    }
+
+    // Quantize the strip and write each of its tiles to their fixed place in the file
+    void flushStrip(size_t l) {
+        LevelState& state = state_[l];
+        const PyramidLevel& level = levels_[l];
+        for (uint32_t ty = 0; ty < level.tilesY; ++ty) {
+            std::fill(tileBuffer_.begin(), tileBuffer_.end(), 0);
+            for (int x = 0; x < state.filled; ++x) {
+                const float* column = &state.strip[size_t(x) * level.rows];
+                for (int y = 0; y < tile_; ++y) {
+                    uint32_t row = ty * tile_ + y;
+                    if (row >= level.rows) break;
+                    tileBuffer_[size_t(y) * tile_ + x] = lut_(column[row]);
+                }
+            }
+            uint64_t tileIndex = uint64_t(ty) * level.tilesX + state.stripIndex;
+            if (!writeAt(tileBuffer_.data(), tileBuffer_.size(), level.offset + tileIndex * tileBytes())) ok_ = false;
+        }
+        state.filled = 0;
+        ++state.stripIndex;
+    }
+
+    bool writeAt(const unsigned char* data, size_t size, uint64_t offset) {
+        while (size > 0) {
+            ssize_t written = pwrite(fd_, data, size, static_cast<off_t>(offset));
+            if (written <= 0) return false;
+            data += written;
+            size -= written;
+            offset += written;
+        }
+        return true;
+    }
+
+    PyramidOptions options_;
+    int tile_;
+    int bins_;
+    StftStream stft_;
+    PyramidHeader header_;
+    std::vector<PyramidLevel> levels_;
+    std::vector<LevelState> state_;
+    std::vector<unsigned char> tileBuffer_;
+    DbLevelLut lut_;
+    uint64_t fileSize_ = 0;
+    int fd_ = -1;
+    bool ok_ = true;
+};
+
+// Render seconds [startSeconds, endSeconds) of one pyramid level to a greyscale image, mapping the
+// file and reading only the tiles the viewport covers
+int renderPyramidView(const char* path, int levelIndex, double startSeconds, double endSeconds, const char* outPath) {
+    int fd = ::open(path, O_RDONLY);
+    struct stat st{};
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(kPyramidPage)) {
+        std::cerr << "Failed to open pyramid: " << path << std::endl;
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+    void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Failed to map pyramid: " << path << std::endl;
+        return 1;
+    }
+    const unsigned char* base = static_cast<const unsigned char*>(mapped);
+    PyramidHeader header;
+    memcpy(&header, base, sizeof(header));
+    PyramidLevel level{};
+    // Trust nothing in the header: every index below must land inside the mapping
+    auto valid = [&] {
+        if (memcmp(header.magic, "SPECPYR1", 8) != 0 || header.sampleRate == 0 || header.hop == 0 ||
+            header.tileSize == 0 || header.numLevels == 0 || header.numLevels > kMaxPyramidLevels ||
+            sizeof(header) + header.numLevels * sizeof(PyramidLevel) > kPyramidPage ||
+            levelIndex < 0 || levelIndex >= int(header.numLevels)) {
+            return false;
+        }
+        memcpy(&level, base + sizeof(header) + levelIndex * sizeof(PyramidLevel), sizeof(level));
+        const uint64_t tile = header.tileSize;
+        uint64_t tileBytes = 0, levelBytes = 0, end = 0;
+        return level.rows > 0 && level.tilesX >= level.columns / tile + (level.columns % tile != 0) &&
+               level.tilesY >= level.rows / tile + (level.rows % tile != 0) &&
+               !__builtin_mul_overflow(tile, tile, &tileBytes) &&
+               !__builtin_mul_overflow(uint64_t(level.tilesX) * level.tilesY, tileBytes, &levelBytes) &&
+               !__builtin_add_overflow(level.offset, levelBytes, &end) && end <= uint64_t(st.st_size);
+    };
+    if (!valid()) {
+        std::cerr << "Not a pyramid file, or no level " << levelIndex << ": " << path << std::endl;
+        munmap(mapped, st.st_size);
+        return 1;
+    }
+
+    double columnsPerSecond = double(header.sampleRate) / header.hop / double(uint64_t(1) << levelIndex);
+    uint64_t first = static_cast<uint64_t>(std::max(0.0, startSeconds) * columnsPerSecond);
+    uint64_t last = std::min<uint64_t>(level.columns, static_cast<uint64_t>(std::ceil(endSeconds * columnsPerSecond)));
+    if (last <= first) {
+        std::cerr << "Empty viewport" << std::endl;
+        munmap(mapped, st.st_size);
+        return 1;
+    }
+
+    const size_t tile = header.tileSize;
+    ImageRowWriter writer;
+    if (!writer.open(outPath, static_cast<int>(last - first), static_cast<int>(level.rows), 1)) {
+        munmap(mapped, st.st_size);
+        return 1;
+    }
+    std::vector<uint8_t> row(last - first);
+    for (uint32_t y = 0; y < level.rows; ++y) {
+        uint32_t r = level.rows - 1 - y;  // Highest frequency on top
+        const unsigned char* tileRow = base + level.offset + (size_t(r / tile) * level.tilesX) * tile * tile;
+        for (uint64_t c = first; c < last; ++c) {
+            row[c - first] = tileRow[(c / tile) * tile * tile + (r % tile) * tile + c % tile];
+        }
+        writer.writeRow(row);
+    }
+    munmap(mapped, st.st_size);
+    if (!writer.finish()) return 1;
+    std::cout << "Rendered level " << levelIndex << " columns " << first << "-" << last << " to " << outPath << std::endl;
+    return 0;
+}
+
+// Scrolling terminal view of per-tone energies and decoded bits. The decoder publishes one frame
+// per symbol into a fixed ring and never waits; a separate thread redraws at the refresh rate and
+// skips frames it has fallen too far behind on.
+class WaterfallDisplay {
+public:
+    static constexpr int kCapacity = 256;
+
+    WaterfallDisplay(double refreshHz, std::vector<std::pair<double, double>> tonePairs)
+        : period_(std::chrono::duration<double>(1.0 / std::max(refreshHz, 0.1))), tonePairs_(std::move(tonePairs)) {}
+
+    ~WaterfallDisplay() { stop(); }
+
+    void start(const char* title) {
+        std::cout << "\x1b[1m" << title << "\x1b[0m\n    time |";
+        for (const auto& [zeroHz, oneHz] : tonePairs_) {
+            std::cout << " " << std::setw(4) << zeroHz << "/" << std::left << std::setw(5) << oneHz << std::right;
+        }
+        std::cout << "| bits\n" << std::flush;
+        running_ = true;
+        thread_ = std::thread([this] { renderLoop(); });
+    }
+
+    // Called from the decode loop: wait-free, overwrites the oldest slot when the ring is full
+    void publish(double timeSeconds, const FskSymbol& symbol) {
+        uint64_t index = written_.load(std::memory_order_relaxed);
+        Slot& slot = slots_[index % kCapacity];
+        slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.time.store(timeSeconds, std::memory_order_relaxed);
+        for (size_t t = 0; t < 2 * tonePairs_.size(); ++t) {
+            slot.energies[t].store(symbol.tone_energy_db[t], std::memory_order_relaxed);
+        }
+        slot.byteValue.store(static_cast<int>(symbol.value), std::memory_order_relaxed);
+        slot.sequence.store(2 * index + 2, std::memory_order_release);
+        written_.store(index + 1, std::memory_order_release);
+    }
+
+    // Draw whatever is still queued, then stop the render thread
+    void stop() {
+        if (!thread_.joinable()) return;
+        running_ = false;
+        thread_.join();
+        drain();
+        if (dropped_) std::cout << "    (" << dropped_ << " rows skipped to keep up)\n";
+        std::cout << std::flush;
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence{0};  // Odd while being written
+        std::atomic<double> time{0};
+        std::atomic<float> energies[2 * FSK_MAX_BITS];
+        std::atomic<int> byteValue{0};
+    };
+
+    void renderLoop() {
+        while (running_) {
+            std::this_thread::sleep_for(period_);
+            drain();
+        }
+    }
+
+    void drain() {
+        uint64_t end = written_.load(std::memory_order_acquire);
+        if (end - read_ > kCapacity) {
+            dropped_ += end - read_ - kCapacity;
+            read_ = end - kCapacity;
+        }
+        for (; read_ < end; ++read_) {
+            Slot& slot = slots_[read_ % kCapacity];
+            uint64_t before = slot.sequence.load(std::memory_order_acquire);
+            double time = slot.time.load(std::memory_order_relaxed);
+            std::array<float, 2 * FSK_MAX_BITS> energies;
+            for (size_t t = 0; t < 2 * tonePairs_.size(); ++t) {
+                energies[t] = slot.energies[t].load(std::memory_order_relaxed);
+            }
+            int byteValue = slot.byteValue.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (before != 2 * read_ + 2 || slot.sequence.load(std::memory_order_relaxed) != before) {
+                ++dropped_;  // Overwritten while we read it
+                continue;
+            }
+            drawRow(time, energies, byteValue);
+        }
+        std::cout << std::flush;
+    }
+
+    // One cell per tone, coloured by energy; the louder tone of each pair is the decided bit
+    void drawRow(double time, const std::array<float, 2 * FSK_MAX_BITS>& energies, int byteValue) {
+        const int numBits = static_cast<int>(tonePairs_.size());
+        std::cout << std::fixed << std::setprecision(1) << std::setw(7) << time << "s |" << std::defaultfloat;
+        for (int bit = 0; bit < numBits; ++bit) {
+            std::cout << " ";
+            for (int value = 0; value < 2; ++value) {
+                float db = energies[2 * bit + value];
+                bool set = ((byteValue >> (numBits - 1 - bit)) & 1) == value;
+                std::cout << "\x1b[48;5;" << colorFor(db) << "m" << (set ? "\x1b[1;97m" : "\x1b[90m") << std::setw(4)
+                          << static_cast<int>(std::lround(db)) << " \x1b[0m";
+            }
+        }
+        std::cout << " | ";
+        for (int bit = 0; bit < numBits; ++bit) std::cout << ((byteValue >> (numBits - 1 - bit)) & 1);
+        if (isprint(byteValue)) std::cout << " (" << char(byteValue) << ")";
+        std::cout << "\n";
+    }
+
+    // xterm-256 ramp from dark blue (-80 dB) through green and yellow to red (0 dB)
+    static int colorFor(float db) {
+        static const int ramp[] = {17, 18, 19, 20, 26, 32, 38, 44, 43, 42, 41, 40, 76, 112, 148, 184, 220, 214, 208, 202, 196};
+        constexpr int steps = std::size(ramp);
+        int index = static_cast<int>((db + 80.0f) / 80.0f * (steps - 1));
+        return ramp[std::clamp(index, 0, steps - 1)];
+    }
+
+    std::chrono::duration<double> period_;
+    std::vector<std::pair<double, double>> tonePairs_;
+    Slot slots_[kCapacity];
+    std::atomic<uint64_t> written_{0};
+    uint64_t read_ = 0;  // Render thread only
+    uint64_t dropped_ = 0;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
+
+struct PsdOptions {
+    std::string csvPath;
+    int segmentSize = 8192;  // Welch segment length; segments overlap by half
+    double bandHz = 500;     // Width of the noise-floor bands
+    int lines = 10;          // Strongest spectral lines to report
+};
+
+// Welch averaged periodogram of a whole file. Each read block is cut into half-overlapping Hann
+// segments that are transformed in parallel; every pool worker accumulates into its own partial
+// sum, and the partials are reduced once at the end, so workers never share a cache line.
+int runPsdSurvey(const char* filename, const PsdOptions& options, ThreadPool& pool) {
+    SF_INFO sfinfo{};
+    SNDFILE* file = sf_open(filename, SFM_READ, &sfinfo);
+    if (!file) {
+        std::cerr << "Failed to open file: " << filename << std::endl;
+        return 1;
+    }
+
+    const int n = options.segmentSize;
+    const int hop = n / 2;
+    const int bins = n / 2 + 1;
+    const int numChannels = sfinfo.channels;
+    const double sampleRate = sfinfo.samplerate;
+    FftPlan plan = makeFftPlan(n);
+
+    std::vector<double> window(n);
+    double windowPower = 0;
+    for (int i = 0; i < n; ++i) {
+        window[i] = 0.5 - 0.5 * std::cos(2 * M_PI * i / n);
+        windowPower += window[i] * window[i];
+    }
+
+    std::vector<std::vector<double>> partials(pool.size(), std::vector<double>(bins, 0.0));
+    std::vector<CArray> scratch(pool.size(), CArray(n + plan.scratchSize()));
+    accountAllocation(MemCategory::Plans, plan.bytes());
+    accountAllocation(MemCategory::Spectra, pool.size() * (bins * sizeof(double) + (n + plan.scratchSize()) * sizeof(Complex)));
+
+    // Mono samples: the tail of the previous block (n - hop frames) followed by the new read
+    const int blockSegments = 64 * pool.size();
+    const int blockFrames = blockSegments * hop;
+    std::vector<double> interleaved(size_t(blockFrames) * numChannels);
+    std::vector<float> mono;
+    mono.reserve(blockFrames + n);
+    accountAllocation(MemCategory::IoBuffers, interleaved.size() * sizeof(double) + mono.capacity() * sizeof(float));
+
+    auto start = std::chrono::steady_clock::now();
+    int64_t totalFrames = 0;
+    int64_t segments = 0;
+    sf_count_t readFrames;
+    while ((readFrames = sf_readf_double(file, interleaved.data(), blockFrames)) > 0) {
+        totalFrames += readFrames;
+        for (sf_count_t i = 0; i < readFrames; ++i) {
+            double sum = 0;
+            for (int ch = 0; ch < numChannels; ++ch) sum += interleaved[i * numChannels + ch];
+            mono.push_back(static_cast<float>(sum / numChannels));
+        }
+        if (static_cast<int>(mono.size()) < n) continue;
+
+        int blockSegmentsReady = (static_cast<int>(mono.size()) - n) / hop + 1;
+        pool.parallelFor(blockSegmentsReady, [&](int segment, int worker) {
+            std::span<Complex> frame(scratch[worker].data(), n);
+            const float* src = &mono[size_t(segment) * hop];
+            for (int i = 0; i < n; ++i) frame[i] = Complex(src[i] * window[i], 0.0);
+            fft(plan, frame, std::span<Complex>(scratch[worker]).subspan(n));
+            std::vector<double>& partial = partials[worker];
+            for (int bin = 0; bin < bins; ++bin) partial[bin] += std::norm(frame[bin]);
+        });
+        segments += blockSegmentsReady;
+        mono.erase(mono.begin(), mono.begin() + size_t(blockSegmentsReady) * hop);
+    }
+    sf_close(file);
+
+    // Reduce the per-worker partial sums
+    std::vector<double> power(bins, 0.0);
+    for (int w = 0; w < pool.size(); ++w) {
+        for (int bin = 0; bin < bins; ++bin) power[bin] += partials[w][bin];
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (segments == 0) {
+        std::cerr << "File shorter than one " << n << "-sample segment: " << filename << std::endl;
+        return 1;
+    }
+
+    // One-sided PSD in dBFS/Hz: |X|^2 / (fs * sum(w^2)), doubled except at DC and Nyquist
+    std::vector<double> psdDb(bins);
+    for (int bin = 0; bin < bins; ++bin) {
+        double psd = power[bin] / segments / (sampleRate * windowPower);
+        if (bin != 0 && bin != n / 2) psd *= 2;
+        psdDb[bin] = 10.0 * std::log10(std::max(psd, 1e-30));
+    }
+    const double binHz = sampleRate / n;
+
+    // Noise floor per band: the median bin is robust to the few lines a band may hold
+    std::cout << "Welch PSD survey: " << filename << "\n  " << segments << " segments of " << n << " samples ("
+              << binHz << " Hz bins), " << double(totalFrames) / sampleRate << " s of audio in " << seconds << " s ("
+              << (double(totalFrames) / sampleRate) / std::max(seconds, 1e-9) << "x real time)\n";
+    std::cout << "\nNoise floor per band (median, dBFS/Hz):\n";
+    int binsPerBand = std::max(1, static_cast<int>(options.bandHz / binHz));
+    std::vector<double> noiseFloor(bins);
+    for (int first = 1; first < bins; first += binsPerBand) {
+        int last = std::min(bins, first + binsPerBand);
+        std::vector<double> band(psdDb.begin() + first, psdDb.begin() + last);
+        std::nth_element(band.begin(), band.begin() + band.size() / 2, band.end());
+        double median = band[band.size() / 2];
+        std::fill(noiseFloor.begin() + first, noiseFloor.begin() + last, median);
+        std::cout << "  " << std::setw(7) << std::lround(first * binHz) << " - " << std::setw(7)
+                  << std::lround(last * binHz) << " Hz: " << std::fixed << std::setprecision(1) << median
+                  << std::defaultfloat << "\n";
+    }
+    noiseFloor[0] = noiseFloor.size() > 1 ? noiseFloor[1] : psdDb[0];
+
+    // Spectral lines: local maxima well above their band's floor, strongest first. Level is the
+    // equivalent sine amplitude in dBFS; frequency is refined by a parabola through the peak.
+    struct Line {
+        double hz;
+        double dbfs;
+        double snrDb;
+    };
+    std::vector<Line> lines;
+    for (int bin = 1; bin + 1 < bins; ++bin) {
+        if (psdDb[bin] <= psdDb[bin - 1] || psdDb[bin] < psdDb[bin + 1] || psdDb[bin] < noiseFloor[bin] + 10) continue;
+        double a = psdDb[bin - 1], b = psdDb[bin], c = psdDb[bin + 1];
+        double denom = a - 2 * b + c;
+        double offset = denom != 0 ? 0.5 * (a - c) / denom : 0.0;
+        double sumWindow = n / 2.0;  // sum of a Hann window
+        double amplitudeSq = 4.0 * (power[bin] / segments) / (sumWindow * sumWindow);
+        lines.push_back({(bin + offset) * binHz, 10.0 * std::log10(std::max(amplitudeSq, 1e-30)), b - noiseFloor[bin]});
+    }
+    std::sort(lines.begin(), lines.end(), [](const Line& x, const Line& y) { return x.dbfs > y.dbfs; });
+    if (static_cast<int>(lines.size()) > options.lines) lines.resize(options.lines);
+
+    std::cout << "\nStrongest spectral lines:\n";
+    for (const Line& line : lines) {
+        std::cout << "  " << std::fixed << std::setprecision(1) << std::setw(9) << line.hz << " Hz  " << std::setw(6)
+                  << line.dbfs << " dBFS  " << std::setw(5) << line.snrDb << " dB above floor" << std::defaultfloat
+                  << "\n";
+    }
+    if (lines.empty()) std::cout << "  (none more than 10 dB above the noise floor)\n";
+
+    if (!options.csvPath.empty()) {
+        std::ofstream csv(options.csvPath);
+        if (!csv) {
+            std::cerr << "Failed to open file: " << options.csvPath << std::endl;
+            return 1;
+        }
+        csv << "frequency_hz,psd_dbfs_per_hz,noise_floor_dbfs_per_hz\n";
+        for (int bin = 0; bin < bins; ++bin) csv << bin * binHz << "," << psdDb[bin] << "," << noiseFloor[bin] << "\n";
+        std::cout << "\nPSD written: " << options.csvPath << std::endl;
+    }
+    std::cout << std::flush;
+    return 0;
+}
+
+// Grid of stream parameters to try on a capture whose settings are unknown
+struct HypothesisOptions {
+    std::vector<double> symbolRates{1.0};
+    std::vector<double> planOffsetsHz{0.0};  // Added to every plan tone
+    int alignments = 1;                      // Start offsets tried: k / alignments of a symbol
+    int ranked = 5;                          // Hypotheses listed on stderr
+};
+
+// Comma-separated numbers, e.g. "0.5,1,2"; empty if any item does not parse
+std::vector<double> parseNumberList(const char* text) {
+    std::vector<double> values;
+    std::stringstream list(text);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        char* end = nullptr;
+        double value = strtod(item.c_str(), &end);
+        if (item.empty() || *end) return {};
+        values.push_back(value);
+    }
+    return values;
+}
+
+// Multi-hypothesis decode: one decoder per grid point, all fed from a single read and channel
+// mix-down of the file, advanced block by block in parallel on the pool. Decoders of the same
+// symbol length share one transform plan. Each decode is scored by its mean per-bit confidence,
+// the gap in dB between a bit's two tones (capped at kMaxMarginDb), and the best one is printed.
+int runHypotheses(const char* filename, const DecoderConfig& base, const HypothesisOptions& options, ThreadPool& pool) {
+    constexpr double kMaxMarginDb = 40;
+    constexpr double kTieDb = 1;  // Scores this close count as equal
+    constexpr size_t kBlockFrames = 1 << 16;
+
+    SF_INFO sfinfo{};
+    SNDFILE* file = sf_open(filename, SFM_READ, &sfinfo);
+    if (!file) {
+        std::cerr << "Failed to open file: " << filename << std::endl;
+        return 1;
+    }
+    const int numChannels = sfinfo.channels;
+
+    struct Hypothesis {
+        DecoderConfig config;
+        double offsetHz = 0;
+        int start = 0;  // Leading frames dropped to shift the symbol grid
+        int skip = 0;   // Of which still to drop
+        std::unique_ptr<FskDecoder> decoder;
+        std::vector<FskSymbol> symbols;
+        double marginDb = 0;
+        size_t bits = 0;
+        double score() const { return bits ? marginDb / bits : 0.0; }
+    };
+    std::vector<Hypothesis> hypotheses;  // Decoder callbacks point into it: no reallocation
+    hypotheses.reserve(options.symbolRates.size() * options.planOffsetsHz.size() * options.alignments);
+    std::map<int, std::shared_ptr<const FftPlan>> plans;
+    for (double rate : options.symbolRates) {
+        for (double offset : options.planOffsetsHz) {
+            for (int k = 0; k < options.alignments; ++k) {
+                Hypothesis h;
+                h.config = base;
+                h.config.sampleRate = sfinfo.samplerate;
+                h.config.channels = 1;  // Mixed down once for all of them
+                h.config.symbolRate = rate;
+                for (auto& [zero, one] : h.config.tonePairs) {
+                    zero += offset;
+                    one += offset;
+                }
+                if (const char* problem = h.config.validate()) {
+                    std::cerr << "Skipping hypothesis " << rate << " symbols/s, " << offset << " Hz: " << problem
+                              << std::endl;
+                    break;
+                }
+                h.offsetHz = offset;
+                const int n = h.config.symbolSamples();
+                h.start = h.skip = static_cast<int>(std::lround(double(k) * n / options.alignments));
+                std::shared_ptr<const FftPlan> plan;
+                if (h.config.detector == Detector::Fft) {
+                    auto& shared = plans[n];
+                    if (!shared) {
+                        shared = std::make_shared<const FftPlan>(makeFftPlan(n, -1, h.config.hugePages));
+                        accountAllocation(MemCategory::Plans, shared->bytes());
+                    }
+                    plan = shared;
+                }
+                hypotheses.push_back(std::move(h));
+                Hypothesis& added = hypotheses.back();
+                added.decoder = std::make_unique<FskDecoder>(
+                    added.config, [&added](const FskSymbol& symbol) { added.symbols.push_back(symbol); }, plan);
+                FskDecoder::Footprint footprint = added.decoder->footprint();
+                accountAllocation(MemCategory::IoBuffers, footprint.ioBytes);
+                accountAllocation(MemCategory::Spectra, footprint.spectraBytes);
+            }
+        }
+    }
+    if (hypotheses.empty()) {
+        sf_close(file);
+        std::cerr << "No usable hypotheses for " << filename << std::endl;
+        return 1;
+    }
+
+    std::vector<double> interleaved(kBlockFrames * numChannels);
+    std::vector<double> mono(kBlockFrames);
+    accountAllocation(MemCategory::IoBuffers, (interleaved.size() + mono.size()) * sizeof(double));
+    auto start = std::chrono::steady_clock::now();
+    sf_count_t readFrames;
+    while ((readFrames = sf_readf_double(file, interleaved.data(), kBlockFrames)) > 0) {
+        for (sf_count_t i = 0; i < readFrames; ++i) {
+            double sum = 0;
+            for (int ch = 0; ch < numChannels; ++ch) sum += interleaved[i * numChannels + ch];
+            mono[i] = sum / numChannels;
+        }
+        pool.parallelFor(static_cast<int>(hypotheses.size()), [&](int index, int) {
+            Hypothesis& h = hypotheses[index];
+            std::span<const double> block(mono.data(), size_t(readFrames));
+            size_t skipped = std::min<size_t>(h.skip, block.size());
+            h.skip -= static_cast<int>(skipped);
+            h.decoder->push(block.subspan(skipped));
+        });
+    }
+    sf_close(file);
+    pool.parallelFor(static_cast<int>(hypotheses.size()), [&](int index, int) {
+        Hypothesis& h = hypotheses[index];
+        h.decoder->flush();
+        for (const FskSymbol& symbol : h.symbols) {
+            for (uint32_t b = 0; b < symbol.num_bits; ++b) {
+                double gap = std::abs(symbol.tone_energy_db[2 * b + 1] - symbol.tone_energy_db[2 * b]);
+                h.marginDb += std::min(gap, kMaxMarginDb);
+                ++h.bits;
+            }
+        }
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Best first. A decode at a multiple of the true rate scores as well as the true one, every
+    // short symbol being clean, so near-ties go to the longer symbol, then the smaller plan
+    // offset and the earlier start
+    std::vector<const Hypothesis*> order;
+    for (const Hypothesis& h : hypotheses) order.push_back(&h);
+    std::sort(order.begin(), order.end(), [](const Hypothesis* a, const Hypothesis* b) { return a->score() > b->score(); });
+    const Hypothesis* best = order.front();
+    for (const Hypothesis* h : order) {
+        if (h->score() < order.front()->score() - kTieDb) break;
+        auto key = [](const Hypothesis* x) {
+            return std::make_tuple(x->config.symbolRate, std::abs(x->offsetHz), x->start);
+        };
+        if (key(h) < key(best)) best = h;
+    }
+
+    std::cerr << "Hypotheses: " << hypotheses.size() << " decoded in one pass in " << std::fixed << std::setprecision(2)
+              << seconds << " s\n";
+    for (int r = 0; r < std::min<int>(options.ranked, order.size()); ++r) {
+        const Hypothesis& h = *order[r];
+        std::cerr << "  " << std::setprecision(3) << std::setw(8) << h.config.symbolRate << " symbols/s  "
+                  << std::showpos << std::setprecision(1) << std::setw(7) << h.offsetHz << std::noshowpos << " Hz  start "
+                  << std::setw(6) << h.start << "  " << std::setw(5) << h.symbols.size() << " symbols  score "
+                  << std::setprecision(1) << h.score() << " dB" << (&h == best ? "  <- best" : "") << "\n";
+    }
+    std::cerr << std::defaultfloat << std::setprecision(6) << std::flush;
+
+    std::cout << "Best hypothesis: " << best->config.symbolRate << " symbols/s, plan offset " << best->offsetHz
+              << " Hz, start frame " << best->start << std::endl;
+    std::string message;
+    for (const FskSymbol& symbol : best->symbols) {
+        printSymbol(symbol);
+        char c = static_cast<char>(symbol.value);
+        message += isprint(c) ? c : '?';
+    }
+    std::cout << "\nDecoded Message: " << message << std::endl;
+    return 0;
+}
+
+// Staged decode: reading, decoding and output run on their own threads and hand work on through
+// SPSC rings, so file I/O, transforms and printing overlap instead of taking turns
+struct PipelineOptions {
+    RingWait wait = RingWait::Futex;
+    std::string pinPolicy = "none";  // Stage k runs on CPU k of pinningOrder(pinPolicy)...
+    int stageCpus[3] = {-1, -1, -1};  // ...unless given here for reader, decode and output
+    int blockFrames = 4096;
+    int blocks = 16;
+};
+
+// CPU for pipeline stage 0 (reader), 1 (decode) or 2 (output); -1 leaves it unpinned
+int stageCpu(const PipelineOptions& options, int stage) {
+    if (options.stageCpus[stage] >= 0) return options.stageCpus[stage];
+    if (options.pinPolicy == "none") return -1;
+    std::vector<int> cpus = pinningOrder(options.pinPolicy);
+    return cpus.empty() ? -1 : cpus[stage % cpus.size()];
+}
+
+// A filled read block on its way from the reader to the decode stage
+struct StageChunk {
+    uint32_t block;
+    uint32_t frames;
+};
+
+// Run the read -> decode -> output stages to the end of `file`. Read blocks cycle through a fixed
+// pool: the reader takes free block ids, the decode stage returns them once pushed. Decoded
+// symbols reach `onSymbol` on the output stage through `symbols`, which `decoder`'s callback fills.
+// The block pool is left untouched here so its pages land on the reader's node.
+template <typename Tap, typename OnSymbol>
+void runStagedDecode(SNDFILE* file, int numChannels, FskDecoder& decoder, SpscRing<FskSymbol>& symbols, Tap tap,
+                     OnSymbol onSymbol, const PipelineOptions& options) {
+    constexpr size_t kBatch = 8;
+    const size_t blockSamples = size_t(options.blockFrames) * numChannels;
+    std::unique_ptr<double[]> pool(new double[options.blocks * blockSamples]);
+    accountAllocation(MemCategory::IoBuffers, options.blocks * blockSamples * sizeof(double));
+
+    SpscRing<StageChunk> filled(options.blocks, options.wait);
+    SpscRing<uint32_t> free(options.blocks, options.wait);
+    for (uint32_t block = 0; block < uint32_t(options.blocks); ++block) free.push(block);
+
+    std::thread reader([&] {
+        pinCurrentThread(stageCpu(options, 0));
+        uint32_t block;
+        while (free.pop(&block, 1)) {
+            double* data = pool.get() + block * blockSamples;
+            sf_count_t frames = sf_readf_double(file, data, options.blockFrames);
+            if (frames <= 0) break;
+            tap(std::span<const double>(data, size_t(frames) * numChannels));
+            filled.push(StageChunk{block, uint32_t(frames)});
+        }
+        filled.close();
+    });
+
+    std::thread decodeStage([&] {
+        pinCurrentThread(stageCpu(options, 1));
+        StageChunk chunks[kBatch];
+        uint32_t done[kBatch];
+        while (size_t n = filled.pop(chunks, kBatch)) {
+            for (size_t k = 0; k < n; ++k) {
+                decoder.push(std::span<const double>(pool.get() + chunks[k].block * blockSamples,
+                                                     size_t(chunks[k].frames) * numChannels));
+                done[k] = chunks[k].block;
+            }
+            free.push(done, n);
+        }
+        decoder.flush();
+        symbols.close();
+    });
+
+    // Output stage on its own thread too, so pinning never sticks to the caller
+    std::thread output([&] {
+        pinCurrentThread(stageCpu(options, 2));
+        FskSymbol batch[kBatch];
+        while (size_t n = symbols.pop(batch, kBatch)) {
+            for (size_t k = 0; k < n; ++k) onSymbol(batch[k]);
+        }
+    });
+
+    reader.join();
+    decodeStage.join();
+    output.join();
+}
+
+// A RIFF/WAVE file of 16-bit PCM or 32-bit float samples, mapped read-only so the decoder reads
+// the samples in place. Anything else (other encodings, other containers) fails open() and goes
+// through libsndfile instead.
+class MappedWav {
+public:
+    MappedWav() = default;
+    MappedWav(const MappedWav&) = delete;
+    MappedWav& operator=(const MappedWav&) = delete;
+    ~MappedWav() {
+        if (map_) munmap(map_, mapBytes_);
+    }
+
+    bool open(const char* filename, bool hugePages) {
+        int fd = ::open(filename, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || st.st_size < 44) {
+            close(fd);
+            return false;
+        }
+        mapBytes_ = size_t(st.st_size);
+        void* map = mmap(nullptr, mapBytes_, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) return false;
+        map_ = map;
+        madvise(map_, mapBytes_, MADV_SEQUENTIAL);
+        if (hugePages) madvise(map_, mapBytes_, MADV_HUGEPAGE);  // Needs read-only file THP; may be ignored
+        return parse();
+    }
+
+    int sampleRate() const { return sampleRate_; }
+    int channels() const { return channels_; }
+    size_t frames() const { return frames_; }
+    bool isFloat() const { return isFloat_; }
+    const void* mapping() const { return map_; }
+
+    // Interleaved samples of `count` frames from `first`; only the one matching isFloat() is valid
+    std::span<const int16_t> s16(size_t first, size_t count) const {
+        return {static_cast<const int16_t*>(samples_) + first * channels_, count * channels_};
+    }
+    std::span<const float> f32(size_t first, size_t count) const {
+        return {static_cast<const float*>(samples_) + first * channels_, count * channels_};
+    }
+
+private:
+    static uint32_t le32(const unsigned char* p) { return p[0] | p[1] << 8 | p[2] << 16 | uint32_t(p[3]) << 24; }
+    static uint16_t le16(const unsigned char* p) { return uint16_t(p[0] | p[1] << 8); }
+
+    bool parse() {
+        if constexpr (std::endian::native != std::endian::little) return false;  // Samples are used in place
+        const auto* bytes = static_cast<const unsigned char*>(map_);
+        if (memcmp(bytes, "RIFF", 4) != 0 || memcmp(bytes + 8, "WAVE", 4) != 0) return false;
+        bool haveFormat = false;
+        for (size_t pos = 12; pos + 8 <= mapBytes_;) {
+            uint32_t chunkBytes = le32(bytes + pos + 4);
+            const unsigned char* body = bytes + pos + 8;
+            size_t available = std::min<size_t>(chunkBytes, mapBytes_ - pos - 8);
+            if (memcmp(bytes + pos, "fmt ", 4) == 0 && available >= 16) {
+                unsigned tag = le16(body);
+                if (tag == 0xFFFE && available >= 26) tag = le16(body + 24);  // WAVE_FORMAT_EXTENSIBLE sub-format
+                channels_ = le16(body + 2);
+                sampleRate_ = int(le32(body + 4));
+                unsigned bits = le16(body + 14);
+                if (tag == 1 && bits == 16) {
+                    isFloat_ = false;
+                } else if (tag == 3 && bits == 32) {
+                    isFloat_ = true;
+                } else {
+                    return false;
+                }
+                haveFormat = channels_ > 0;
+            } else if (memcmp(bytes + pos, "data", 4) == 0 && haveFormat) {
+                size_t frameBytes = size_t(channels_) * (isFloat_ ? sizeof(float) : sizeof(int16_t));
+                if ((body - bytes) % (isFloat_ ? alignof(float) : alignof(int16_t)) != 0) return false;
+                samples_ = body;
+                frames_ = available / frameBytes;
+                return true;
+            }
+            pos += 8 + size_t(chunkBytes) + (chunkBytes & 1);  // Chunks are padded to even sizes
+        }
+        return false;
+    }
+
+    void* map_ = nullptr;
+    size_t mapBytes_ = 0;
+    const void* samples_ = nullptr;
+    int sampleRate_ = 0;
+    int channels_ = 0;
+    size_t frames_ = 0;
+    bool isFloat_ = false;
+};
+
+// Visual products built from the same read pass as the decode; null members are skipped
+struct FileOutputs {
+    const SpectrogramOptions* spectrogram = nullptr;
+    const PyramidOptions* pyramid = nullptr;
+    ThreadPool* pool = nullptr;
+    double waterfallHz = 0;                     // Terminal waterfall refresh rate; 0 disables it
+    const PipelineOptions* pipeline = nullptr;  // Staged decode; null decodes inline
+    bool mmapInput = false;                     // Read WAV samples in place instead of through libsndfile
+    bool jsonReport = false;                    // Format of the --huge-pages backing report
+    DetectorTuner* tuner = nullptr;             // Picks the detector per stream format; null keeps base's
+};
+
+// Decode one file and print its message, building any requested outputs in the same pass.
+// `base` supplies the tone plan and decoder options; the stream format comes from the file.
+// Returns 0 on success.
+int decodeFile(const char* filename, const DecoderConfig& base, const FileOutputs& outputs = {}) {
+    const bool hugePages = base.hugePages;
+    SNDFILE* file = nullptr;
+    SF_INFO sfinfo{};
+
+    // The staged pipeline has its own reader thread, which reads through libsndfile
+    std::optional<MappedWav> mapped;
+    if (outputs.mmapInput && !outputs.pipeline) {
+        mapped.emplace();
+        if (!mapped->open(filename, hugePages)) mapped.reset();
+    }
+    if (mapped) {
+        sfinfo.channels = mapped->channels();
+        sfinfo.samplerate = mapped->sampleRate();
+        sfinfo.frames = sf_count_t(mapped->frames());
+    } else {
+        file = sf_open(filename, SFM_READ, &sfinfo);
+        if (!file) {
+            std::cerr << "Failed to open file: " << filename << std::endl;
+            return 1;
+        }
+    }
+
+    int numChannels = sfinfo.channels;
+    int sampleRate = sfinfo.samplerate;
+
+    DecoderConfig config = base;
+    config.sampleRate = sampleRate;
+    config.channels = numChannels;
+    if (outputs.pipeline) config.numaNode = cpuNode(stageCpu(*outputs.pipeline, 1));  // Local to the decode stage
+    if (const char* problem = config.validate()) {
+        std::cerr << "Unsupported stream format: " << filename << " (" << problem << ")" << std::endl;
+        if (file) sf_close(file);
+        return 1;
+    }
+    if (outputs.tuner) config.detector = outputs.tuner->choose(config);
+
+    std::optional<SpectrogramRenderer> renderer;
+    if (outputs.spectrogram) renderer.emplace(*outputs.spectrogram, sampleRate, sfinfo.frames, *outputs.pool);
+    std::optional<SpectrogramPyramid> pyramid;
+    if (outputs.pyramid) {
+        pyramid.emplace(*outputs.pyramid, sampleRate, sfinfo.frames, *outputs.pool);
+        if (!pyramid->open()) {
+            std::cerr << "Failed to create pyramid: " << outputs.pyramid->path << std::endl;
+            if (file) sf_close(file);
+            return 1;
+        }
+    }
+
+    // The waterfall replaces the per-chunk text dump
+    std::optional<WaterfallDisplay> waterfall;
+    if (outputs.waterfallHz > 0) {
+        waterfall.emplace(outputs.waterfallHz, config.tonePairs);
+        waterfall->start(filename);
+    }
+
+    std::vector<char> asciiMessage;
+    auto onSymbol = [&](const FskSymbol& symbol) {
+        asciiMessage.push_back(static_cast<char>(symbol.value));
+        if (waterfall) {
+            waterfall->publish(double(symbol.first_frame + symbol.frames) / sampleRate, symbol);
+        } else {
+            printSymbol(symbol);
+        }
+    };
+    auto tap = [&](std::span<const double> samples) {
+        if (renderer) renderer->push(samples, numChannels);
+        if (pyramid) pyramid->push(samples, numChannels);
+    };
+
+    std::optional<SpscRing<FskSymbol>> symbolRing;
+    if (outputs.pipeline) symbolRing.emplace(64, outputs.pipeline->wait);
+    FskDecoder decoder(config, [&](const FskSymbol& symbol) {
+        if (symbolRing) {
+            symbolRing->push(symbol);
+        } else {
+            onSymbol(symbol);
+        }
+    });
+    accountDecoder(decoder);
+
+    if (outputs.pipeline) {
+        runStagedDecode(file, numChannels, decoder, *symbolRing, tap, onSymbol, *outputs.pipeline);
+    } else if (mapped) {
+        // Native samples go straight from the mapping to the decoder; only the visual taps need
+        // them widened to doubles
+        const size_t blockFrames = config.symbolSamples();
+        std::vector<double> widened;
+        if (renderer || pyramid) {
+            widened.resize(blockFrames * numChannels);
+            accountAllocation(MemCategory::IoBuffers, widened.size() * sizeof(double));
+        }
+        const double scale = mapped->isFloat() ? 1.0 : 1.0 / 32768.0;
+        for (size_t first = 0; first < mapped->frames(); first += blockFrames) {
+            size_t count = std::min(blockFrames, mapped->frames() - first);
+            if (mapped->isFloat()) {
+                std::span<const float> samples = mapped->f32(first, count);
+                if (!widened.empty()) {
+                    std::transform(samples.begin(), samples.end(), widened.begin(), [&](float v) { return v * scale; });
+                }
+                decoder.push(samples);
+            } else {
+                std::span<const int16_t> samples = mapped->s16(first, count);
+                if (!widened.empty()) {
+                    std::transform(samples.begin(), samples.end(), widened.begin(), [&](int16_t v) { return v * scale; });
+                }
+                decoder.push(samples);
+            }
+            if (!widened.empty()) tap(std::span<const double>(widened.data(), count * numChannels));
+        }
+        decoder.flush();
+    } else {
+        // Reads are sized to a symbol so the text dump keeps pace with the file
+        const size_t blockFrames = config.symbolSamples();
+        std::vector<double> block(blockFrames * numChannels);
+        accountAllocation(MemCategory::IoBuffers, block.size() * sizeof(double));
+
+        sf_count_t readSamples;
+        while ((readSamples = sf_readf_double(file, block.data(), blockFrames)) > 0) {
+            std::span<const double> samples(block.data(), size_t(readSamples) * numChannels);
+            tap(samples);
+            decoder.push(samples);
+        }
+        decoder.flush();
+    }
+
+    if (file) sf_close(file);
+    if (waterfall) waterfall->stop();
+
+    // Asking for huge pages is only a hint at several levels; report what each buffer really got
+    if (hugePages) {
+        printHugePageReport(filename,
+                            {{"decoder_arena", decoder.arena().data()},
+                             {"plan_twiddles", decoder.plan() ? decoder.plan()->storage.data() : nullptr},
+                             {"input_mapping", mapped ? mapped->mapping() : nullptr}},
+                            outputs.jsonReport);
+    }
+
+    if (config.coarseToFine) {
+        std::cerr << "Coarse-to-fine: " << decoder.coarseSymbols() << " of " << asciiMessage.size()
+                  << " symbols decided from " << decoder.coarseFrames() << "-frame windows" << std::endl;
+    }
+    if (config.clockRecovery) {
+        std::cerr << "Clock offset: " << std::showpos << std::fixed << std::setprecision(1) << decoder.clockOffsetPpm()
+                  << std::noshowpos << std::defaultfloat << std::setprecision(6) << " ppm (corrected)" << std::endl;
+    }
+
+    std::cout << "\nDecoded Message: ";
+    for (char c : asciiMessage) {
+        if (isprint(c)) {
+            std::cout << c;
+        } else {
+            std::cout << "?"; // Replace non-printable characters
+        }
+    }
+    std::cout << std::endl;
+
+    if (renderer) {
+        if (!renderer->finish()) {
+            std::cerr << "Failed to write spectrogram: " << outputs.spectrogram->path << std::endl;
+            return 1;
+        }
+        std::cout << "Spectrogram written: " << outputs.spectrogram->path << std::endl;
+    }
+
+    if (pyramid) {
+        if (!pyramid->finish()) {
+            std::cerr << "Failed to write pyramid: " << outputs.pyramid->path << std::endl;
+            return 1;
+        }
+        std::cout << "Pyramid written: " << outputs.pyramid->path << " (" << pyramid->numLevels() << " levels, "
+                  << pyramid->fileSize() / 1024 << " KiB)" << std::endl;
+    }
+
+    return 0;
+}
+
+// Decode daemon: one long-running process serves decode jobs over a Unix domain socket, so a
+// short clip costs a request round trip instead of a process start and a fresh plan.
+//
+// Requests are text lines; each gets one JSON line back, in order, on the same connection:
+//   FILE <path>                          decode a sound file the daemon can open
+//   PCM <s16|f32|f64> <rate> <ch> <n>    decode the n bytes of interleaved native-endian PCM that follow
+//   FD                                   decode the sound file whose descriptor came with the line (SCM_RIGHTS)
+//   FD <s16|f32|f64> <rate> <ch>         read raw PCM from the passed descriptor until EOF
+//   STATS                                jobs served, open connections, cached plans and workers
+// Every connection is a coroutine on a small executor. It parks in epoll whenever its client or
+// PCM source has nothing to give, and decodes on whichever worker resumes it, so an idle or slow
+// stream holds a coroutine frame rather than a thread.
+
+enum class PcmFormat { S16, F32, F64 };
+
+bool parsePcmFormat(const std::string& name, PcmFormat& format) {
+    if (name == "s16") format = PcmFormat::S16;
+    else if (name == "f32") format = PcmFormat::F32;
+    else if (name == "f64") format = PcmFormat::F64;
+    else return false;
+    return true;
+}
+
+size_t pcmSampleBytes(PcmFormat format) {
+    switch (format) {
+        case PcmFormat::S16: return sizeof(int16_t);
+        case PcmFormat::F32: return sizeof(float);
+        default: return sizeof(double);
+    }
+}
+
+// Plans shared by every job, one per symbol length and placement; built on first use and kept for
+// the life of the daemon
+class PlanCache {
+public:
+    // The FFT plan `config` needs, placed the way it asks (NUMA node, huge pages)
+    std::shared_ptr<const FftPlan> get(const DecoderConfig& config) {
+        const int n = config.symbolSamples();
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::shared_ptr<const FftPlan>& plan = plans_[{n, config.numaNode, config.hugePages}];
+        if (!plan) {
+            plan = std::make_shared<const FftPlan>(makeFftPlan(n, config.numaNode, config.hugePages));
+            accountAllocation(MemCategory::Plans, plan->bytes());
+        }
+        return plan;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return plans_.size();
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<std::tuple<int, int, bool>, std::shared_ptr<const FftPlan>> plans_;
+};
+
+// Decoders kept warm between jobs, with a free list per stream format. A job leases one for its
+// whole run, whichever executor thread each of its steps resumes on. Every decoder is built from
+// the command line's configuration with only the stream format filled in per job.
+class DecoderPool {
+public:
+    struct Lease {
+        std::unique_ptr<FskDecoder> decoder;
+        std::vector<int> values;    // Symbols of the current job
+        uint64_t frames = 0;        // Stream position after the last symbol
+        std::vector<double> block;  // Read buffer
+    };
+
+    DecoderPool(PlanCache& plans, const DecoderConfig& base) : plans_(plans), base_(base) {}
+
+    // Null with `error` set when the format cannot be decoded
+    std::unique_ptr<Lease> acquire(int sampleRate, int channels, const char*& error) {
+        std::unique_ptr<Lease> lease;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::vector<std::unique_ptr<Lease>>& spare = free_[{sampleRate, channels}];
+            if (!spare.empty()) {
+                lease = std::move(spare.back());
+                spare.pop_back();
+            }
+        }
+        if (!lease) {
+            DecoderConfig config = base_;
+            config.sampleRate = sampleRate;
+            config.channels = channels;
+            if ((error = config.validate())) return nullptr;
+            lease = std::make_unique<Lease>();
+            Lease* owner = lease.get();
+            // Only the FFT detector transforms; the others would build, cache and report a plan for nothing
+            std::shared_ptr<const FftPlan> plan = config.detector == Detector::Fft ? plans_.get(config) : nullptr;
+            lease->decoder = std::make_unique<FskDecoder>(config, [owner](const FskSymbol& symbol) {
+                owner->values.push_back(static_cast<int>(symbol.value));
+                owner->frames = symbol.first_frame + symbol.frames;
+            }, std::move(plan));
+            accountDecoder(*lease->decoder);
+        }
+        lease->decoder->reset();
+        lease->values.clear();
+        lease->frames = 0;
+        return lease;
+    }
+
+    void release(std::unique_ptr<Lease> lease) {
+        const DecoderConfig& config = lease->decoder->config();
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_[{config.sampleRate, config.channels}].push_back(std::move(lease));
+    }
+
+private:
+    PlanCache& plans_;
+    const DecoderConfig base_;
+    std::mutex mutex_;
+    std::map<std::pair<int, int>, std::vector<std::unique_ptr<Lease>>> free_;
+};
+
+// A client connection and the bytes (and passed descriptors) received but not yet consumed. The
+// socket is non-blocking; every wait is a co_await on the executor.
+struct DaemonConnection {
+    Executor& executor;
+    int fd;
+    std::string pending;
+    std::deque<int> passedFds;
+
+    DaemonConnection(Executor& executor, int fd) : executor(executor), fd(fd) {}
+    DaemonConnection(const DaemonConnection&) = delete;
+    DaemonConnection& operator=(const DaemonConnection&) = delete;
+
+    ~DaemonConnection() {
+        for (int passed : passedFds) close(passed);
+        close(fd);
+    }
+
+    // Receive more bytes, collecting any descriptors that ride along; 0 on EOF, -1 on error
+    Task<ssize_t> receive() {
+        constexpr size_t kChunk = 4096;
+        const size_t before = pending.size();
+        alignas(cmsghdr) char control[CMSG_SPACE(4 * sizeof(int))];
+        iovec iov{};
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        ssize_t got;
+        for (;;) {
+            pending.resize(before + kChunk);
+            iov = {pending.data() + before, kChunk};
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            got = recvmsg(fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+            if (got < 0 && errno == EINTR) continue;
+            if (got >= 0 || errno != EAGAIN) break;
+            // Parked connections give their buffer back, so an idle one is little more than its frame
+            pending.resize(before);
+            if (pending.empty()) pending.shrink_to_fit();
+            co_await executor.readable(fd);
+        }
+        pending.resize(before + std::max<ssize_t>(got, 0));
+        if (got < 0) co_return -1;
+        for (cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+            if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS) continue;
+            size_t count = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (size_t k = 0; k < count; ++k) {
+                int passed;
+                memcpy(&passed, CMSG_DATA(c) + k * sizeof(int), sizeof(int));
+                passedFds.push_back(passed);
+            }
+        }
+        co_return got;
+    }
+
+    // Copy up to `size` payload bytes into `out`, buffered bytes first; 0 on EOF
+    Task<ssize_t> read(void* out, size_t size) {
+        if (pending.empty() && co_await receive() <= 0) co_return 0;
+        size_t take = std::min(size, pending.size());
+        memcpy(out, pending.data(), take);
+        pending.erase(0, take);
+        co_return ssize_t(take);
+    }
+
+    Task<bool> send(const std::string& line) {
+        for (size_t sent = 0; sent < line.size();) {
+            ssize_t wrote = ::send(fd, line.data() + sent, line.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (wrote < 0 && errno == EAGAIN) {
+                co_await executor.writable(fd);
+                continue;
+            }
+            if (wrote < 0 && errno == EINTR) continue;
+            if (wrote <= 0) co_return false;
+            sent += size_t(wrote);
+        }
+        co_return true;
+    }
+};
+
+std::string jsonError(const std::string& error) { return "{\"status\":\"error\",\"error\":" + jsonString(error) + "}\n"; }
+
+volatile sig_atomic_t g_daemonStop = 0;
+int g_daemonWakeFd = -1;
+
+extern "C" void stopDaemon(int) {
+    g_daemonStop = 1;
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t ignored = write(g_daemonWakeFd, &one, sizeof(one));
+}
+
+class DecodeDaemon {
+public:
+    DecodeDaemon(int workers, const DecoderConfig& base)
+        : workerCount_(std::max(1, workers)), decoders_(plans_, base), executor_(workerCount_) {}
+
+    int run(const char* socketPath) {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (strlen(socketPath) >= sizeof(addr.sun_path)) {
+            std::cerr << "Socket path too long: " << socketPath << std::endl;
+            return 1;
+        }
+        strcpy(addr.sun_path, socketPath);
+
+        int listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        unlink(socketPath);  // A stale socket from an earlier run
+        if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            listen(listenFd, SOMAXCONN) != 0) {
+            std::cerr << "Cannot listen on " << socketPath << ": " << strerror(errno) << std::endl;
+            if (listenFd >= 0) close(listenFd);
+            return 1;
+        }
+        g_daemonWakeFd = eventfd(0, EFD_CLOEXEC);
+        signal(SIGINT, stopDaemon);
+        signal(SIGTERM, stopDaemon);
+
+        std::cout << "Decode daemon listening on " << socketPath << " with " << workerCount_ << " workers" << std::endl;
+        executor_.spawn(acceptLoop(listenFd));
+
+        // Everything runs on the executor; this thread only waits for SIGINT or SIGTERM
+        while (!g_daemonStop) {
+            uint64_t count;
+            [[maybe_unused]] ssize_t ignored = ::read(g_daemonWakeFd, &count, sizeof(count));
+        }
+
+        // Parked connections are abandoned to process exit
+        executor_.stop();
+        close(listenFd);
+        unlink(socketPath);
+        std::cout << "Decode daemon stopped after " << jobs_.load() << " jobs" << std::endl;
+        return 0;
+    }
+
+private:
+    static constexpr size_t kMaxLine = 65536;
+
+    DetachedTask acceptLoop(int listenFd) {
+        for (;;) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd >= 0) {
+                executor_.spawn(serveConnection(fd));
+            } else if (errno == EAGAIN) {
+                co_await executor_.readable(listenFd);
+            } else if (errno != EINTR && errno != ECONNABORTED) {
+                std::cerr << "accept failed: " << strerror(errno) << std::endl;
+                co_return;
+            }
+        }
+    }
+
+    DetachedTask serveConnection(int fd) {
+        DaemonConnection connection(executor_, fd);
+        ++connections_;
+        for (;;) {
+            size_t newline = connection.pending.find('\n');
+            if (newline == std::string::npos) {
+                if (connection.pending.size() > kMaxLine) {
+                    co_await connection.send(jsonError("request line too long"));
+                    break;
+                }
+                if (co_await connection.receive() <= 0) break;
+                continue;
+            }
+            std::string line = connection.pending.substr(0, newline);
+            connection.pending.erase(0, newline + 1);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            std::string reply = co_await handle(line, connection);
+            if (!co_await connection.send(reply)) break;
+        }
+        --connections_;
+    }
+
+    Task<std::string> handle(const std::string& line, DaemonConnection& connection) {
+        std::istringstream request(line);
+        std::string verb;
+        request >> verb;
+        if (verb == "FILE") {
+            std::string path;
+            std::getline(request >> std::ws, path);
+            ++jobs_;
+            SF_INFO info{};
+            SNDFILE* file = sf_open(path.c_str(), SFM_READ, &info);
+            if (!file) co_return jsonError("cannot open " + path);
+            co_return decodeSndfile(file, info);
+        }
+        if (verb == "PCM" || verb == "FD") {
+            std::string formatName;
+            int sampleRate = 0, channels = 0;
+            uint64_t bytes = UINT64_MAX;
+            request >> formatName;
+            PcmFormat format{};
+            bool raw = !formatName.empty();
+            if (raw && !(parsePcmFormat(formatName, format) && request >> sampleRate >> channels)) {
+                co_return jsonError("expected " + verb + " <s16|f32|f64> <rate> <channels>" + (verb == "PCM" ? " <bytes>" : ""));
+            }
+            if (verb == "PCM") {
+                if (!raw || !(request >> bytes)) co_return jsonError("expected PCM <s16|f32|f64> <rate> <channels> <bytes>");
+                ++jobs_;
+                co_return co_await decodePcm(format, sampleRate, channels, bytes,
+                                             [&](void* out, size_t size) { return connection.read(out, size); });
+            }
+            if (connection.passedFds.empty()) co_return jsonError("FD request without a passed descriptor");
+            int fd = connection.passedFds.front();
+            connection.passedFds.pop_front();
+            ++jobs_;
+            if (!raw) {
+                SF_INFO info{};
+                SNDFILE* file = sf_open_fd(fd, SFM_READ, &info, 1);
+                if (!file) {
+                    close(fd);
+                    co_return jsonError("passed descriptor is not a readable sound file");
+                }
+                co_return decodeSndfile(file, info);
+            }
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            std::string result = co_await decodePcm(format, sampleRate, channels, UINT64_MAX,
+                                                    [&](void* out, size_t size) { return readFd(fd, out, size); });
+            close(fd);
+            co_return result;
+        }
+        if (verb == "STATS") {
+            co_return "{\"status\":\"ok\",\"jobs\":" + std::to_string(jobs_.load()) + ",\"connections\":" +
+                std::to_string(connections_.load()) + ",\"plans\":" + std::to_string(plans_.size()) +
+                ",\"workers\":" + std::to_string(workerCount_) + "}\n";
+        }
+        co_return jsonError("unknown request: " + verb);
+    }
+
+    // Read from a non-blocking pipe or socket, parking while it is empty
+    Task<ssize_t> readFd(int fd, void* out, size_t size) {
+        for (;;) {
+            ssize_t got = ::read(fd, out, size);
+            if (got >= 0 || (errno != EAGAIN && errno != EINTR)) co_return got;
+            if (errno == EAGAIN) co_await executor_.readable(fd);
+        }
+    }
+
+    // Sound files are read synchronously: regular file reads do not park
+    std::string decodeSndfile(SNDFILE* file, const SF_INFO& info) {
+        const char* error = nullptr;
+        std::unique_ptr<DecoderPool::Lease> lease = decoders_.acquire(info.samplerate, info.channels, error);
+        if (!lease) {
+            sf_close(file);
+            return jsonError(error);
+        }
+        auto start = std::chrono::steady_clock::now();
+        const size_t blockFrames = 8192;
+        if (lease->block.size() < blockFrames * info.channels) lease->block.resize(blockFrames * info.channels);
+        sf_count_t got;
+        while ((got = sf_readf_double(file, lease->block.data(), blockFrames)) > 0) {
+            lease->decoder->push(std::span<const double>(lease->block.data(), size_t(got) * info.channels));
+        }
+        sf_close(file);
+        return finish(std::move(lease), start);
+    }
+
+    // Decode raw interleaved PCM pulled from `co_await read(buffer, size)` until it returns 0 or
+    // `limit` bytes have been consumed; `read` returns -1 on error
+    template <typename Read>
+    Task<std::string> decodePcm(PcmFormat format, int sampleRate, int channels, uint64_t limit, Read read) {
+        const char* error = nullptr;
+        std::unique_ptr<DecoderPool::Lease> lease = decoders_.acquire(sampleRate, channels, error);
+        if (!lease) co_return jsonError(error);
+        auto start = std::chrono::steady_clock::now();
+        const size_t frameBytes = pcmSampleBytes(format) * channels;
+        const size_t blockBytes = std::max<size_t>(65536 / frameBytes, 1) * frameBytes;
+        if (lease->block.size() * sizeof(double) < blockBytes) lease->block.resize(blockBytes / sizeof(double) + 1);
+        unsigned char* bytes = reinterpret_cast<unsigned char*>(lease->block.data());
+        FskDecoder& decoder = *lease->decoder;
+
+        uint64_t consumed = 0;
+        size_t held = 0;  // Bytes of a partial frame carried into the next read
+        while (consumed < limit) {
+            ssize_t got = co_await read(bytes + held, std::min<uint64_t>(blockBytes - held, limit - consumed));
+            if (got < 0) {
+                decoders_.release(std::move(lease));
+                co_return jsonError("read failed");
+            }
+            if (got == 0) break;
+            consumed += uint64_t(got);
+            held += size_t(got);
+            size_t frames = held / frameBytes;
+            size_t samples = frames * channels;
+            switch (format) {
+                case PcmFormat::S16: decoder.push(std::span<const int16_t>(reinterpret_cast<int16_t*>(bytes), samples)); break;
+                case PcmFormat::F32: decoder.push(std::span<const float>(reinterpret_cast<float*>(bytes), samples)); break;
+                case PcmFormat::F64: decoder.push(std::span<const double>(reinterpret_cast<double*>(bytes), samples)); break;
+            }
+            memmove(bytes, bytes + frames * frameBytes, held - frames * frameBytes);
+            held -= frames * frameBytes;
+        }
+        if (limit != UINT64_MAX && consumed < limit) {
+            decoders_.release(std::move(lease));
+            co_return jsonError("stream ended before the payload did");
+        }
+        co_return finish(std::move(lease), start);
+    }
+
+    std::string finish(std::unique_ptr<DecoderPool::Lease> lease, std::chrono::steady_clock::time_point start) {
+        lease->decoder->flush();
+        double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        std::string message;
+        std::string values;
+        for (int value : lease->values) {
+            message += isprint(value) ? static_cast<char>(value) : '?';
+            values += (values.empty() ? "" : ",") + std::to_string(value);
+        }
+        std::ostringstream out;
+        out << "{\"status\":\"ok\",\"message\":" << jsonString(message) << ",\"values\":[" << values
+            << "],\"symbols\":" << lease->values.size()
+            << ",\"seconds\":" << double(lease->frames) / lease->decoder->config().sampleRate
+            << ",\"decode_us\":" << std::lround(micros) << "}\n";
+        decoders_.release(std::move(lease));
+        return out.str();
+    }
+
+    int workerCount_;
+    PlanCache plans_;
+    DecoderPool decoders_;
+    std::atomic<uint64_t> jobs_{0};
+    std::atomic<int> connections_{0};
+    Executor executor_;  // Last: its threads stop before the state they use goes away
+};
+
+int main(int argc, char* argv[]) {
+    std::vector<const char*> filenames;
+    bool allocCheck = false;
+    bool hugePages = false;
+    bool mmapInput = false;
+    Detector detector = Detector::Fft;
+    bool autotune = false;
+    std::optional<double> cfarThresholdDb;
+    std::optional<double> coarseConfidenceDb;
+    bool excision = false;
+    bool clockRecovery = false;
+    std::optional<HypothesisOptions> hypotheses;
+    std::string detectorCache = DetectorTuner::defaultCachePath();
+    int scalingThreads = 0;
+    std::string pinPolicy = "none";
+    std::string reportFormat;
+    std::optional<SpectrogramOptions> spectrogram;
+    std::optional<PyramidOptions> pyramid;
+    const char* pyramidView[5] = {};
+    double waterfallHz = 0;
+    std::optional<PsdOptions> psd;
+    const char* servePath = nullptr;
+    std::optional<PipelineOptions> pipeline;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Parsing command-line arguments
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            filenames.push_back(argv[++i]);
+        } else if (argv[i][0] != '-') {
+            filenames.push_back(argv[i]);
+        } else if (strcmp(argv[i], "--alloc-check") == 0) {
+            allocCheck = true;
+        } else if (strcmp(argv[i], "--huge-pages") == 0) {
+            hugePages = true;
+        } else if (strcmp(argv[i], "--mmap") == 0) {
+            mmapInput = true;
+        } else if (strcmp(argv[i], "--detector") == 0 && i + 1 < argc) {
+            autotune = strcmp(argv[++i], "auto") == 0;
+            if (!autotune && !parseDetector(argv[i], detector)) {
+                std::cerr << "Unknown detector: " << argv[i] << " (fft, goertzel, tone-bank or auto)" << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--cfar") == 0) {
+            cfarThresholdDb = DecoderConfig().cfarThresholdDb;
+            if (i + 1 < argc && (isdigit(static_cast<unsigned char>(argv[i + 1][0])) || argv[i + 1][0] == '.')) {
+                cfarThresholdDb = atof(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--coarse-to-fine") == 0) {
+            coarseConfidenceDb = DecoderConfig().coarseConfidenceDb;
+            if (i + 1 < argc && (isdigit(static_cast<unsigned char>(argv[i + 1][0])) || argv[i + 1][0] == '.')) {
+                coarseConfidenceDb = atof(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--excise") == 0) {
+            excision = true;
+        } else if (strcmp(argv[i], "--clock-recovery") == 0) {
+            clockRecovery = true;
+        } else if (strcmp(argv[i], "--hypotheses") == 0) {
+            if (!hypotheses) hypotheses.emplace();
+        } else if ((strcmp(argv[i], "--hyp-rates") == 0 || strcmp(argv[i], "--hyp-offsets") == 0) && i + 1 < argc) {
+            if (!hypotheses) hypotheses.emplace();
+            bool rates = strcmp(argv[i], "--hyp-rates") == 0;
+            std::vector<double> values = parseNumberList(argv[++i]);
+            if (values.empty()) {
+                std::cerr << "Expected comma-separated numbers: " << argv[i] << std::endl;
+                return 1;
+            }
+            (rates ? hypotheses->symbolRates : hypotheses->planOffsetsHz) = values;
+        } else if (strcmp(argv[i], "--hyp-align") == 0 && i + 1 < argc) {
+            if (!hypotheses) hypotheses.emplace();
+            hypotheses->alignments = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--detector-cache") == 0 && i + 1 < argc) {
+            detectorCache = argv[++i];
+        } else if (strcmp(argv[i], "--bench-scaling") == 0) {
+            scalingThreads = std::max(1u, std::thread::hardware_concurrency());
+            if (i + 1 < argc && argv[i + 1][0] != '-') scalingThreads = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--pin") == 0 && i + 1 < argc) {
+            pinPolicy = argv[++i];
+        } else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc) {
+            reportFormat = argv[++i];
+        } else if (strcmp(argv[i], "--spectrogram") == 0 && i + 1 < argc) {
+            if (!spectrogram) spectrogram.emplace();
+            spectrogram->path = argv[++i];
+        } else if (strcmp(argv[i], "--spectrogram-width") == 0 && i + 1 < argc) {
+            if (!spectrogram) spectrogram.emplace();
+            spectrogram->width = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--spectrogram-window") == 0 && i + 1 < argc) {
+            if (!spectrogram) spectrogram.emplace();
+            spectrogram->windowSize = std::max(16, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--spectrogram-max-hz") == 0 && i + 1 < argc) {
+            if (!spectrogram) spectrogram.emplace();
+            spectrogram->maxHz = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--pyramid") == 0 && i + 1 < argc) {
+            if (!pyramid) pyramid.emplace();
+            pyramid->path = argv[++i];
+        } else if (strcmp(argv[i], "--pyramid-window") == 0 && i + 1 < argc) {
+            if (!pyramid) pyramid.emplace();
+            pyramid->windowSize = std::max(16, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--pyramid-tile") == 0 && i + 1 < argc) {
+            if (!pyramid) pyramid.emplace();
+            pyramid->tileSize = std::max(64, atoi(argv[++i]) / 64 * 64);  // Whole pages per tile
+        } else if (strcmp(argv[i], "--pyramid-pooling") == 0 && i + 1 < argc) {
+            if (!pyramid) pyramid.emplace();
+            pyramid->meanPooling = strcmp(argv[++i], "mean") == 0;
+        } else if (strcmp(argv[i], "--pyramid-view") == 0 && i + 5 < argc) {
+            for (int k = 0; k < 5; ++k) pyramidView[k] = argv[++i];
+        } else if (strcmp(argv[i], "--waterfall") == 0) {
+            waterfallHz = 10;
+            if (i + 1 < argc && argv[i + 1][0] != '-' && atof(argv[i + 1]) > 0) waterfallHz = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--psd") == 0) {
+            if (!psd) psd.emplace();
+            if (i + 1 < argc && argv[i + 1][0] != '-') psd->csvPath = argv[++i];
+        } else if (strcmp(argv[i], "--psd-segment") == 0 && i + 1 < argc) {
+            if (!psd) psd.emplace();
+            psd->segmentSize = std::max(16, atoi(argv[++i]) / 2 * 2);
+        } else if (strcmp(argv[i], "--psd-band") == 0 && i + 1 < argc) {
+            if (!psd) psd.emplace();
+            psd->bandHz = std::max(1.0, atof(argv[++i]));
+        } else if (strcmp(argv[i], "--psd-lines") == 0 && i + 1 < argc) {
+            if (!psd) psd.emplace();
+            psd->lines = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--pipeline") == 0) {
+            if (!pipeline) pipeline.emplace();
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                pipeline->wait = strcmp(argv[++i], "spin") == 0 ? RingWait::Spin : RingWait::Futex;
+            }
+        } else if (strcmp(argv[i], "--pin-stages") == 0 && i + 1 < argc) {
+            if (!pipeline) pipeline.emplace();
+            int* cpus = pipeline->stageCpus;
+            sscanf(argv[++i], "%d,%d,%d", &cpus[0], &cpus[1], &cpus[2]);
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            servePath = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = std::max(1, atoi(argv[++i]));
+        }
+    }
+
+    if (pyramidView[0]) {
+        return renderPyramidView(pyramidView[0], atoi(pyramidView[1]), atof(pyramidView[2]), atof(pyramidView[3]),
+                                 pyramidView[4]);
+    }
+
+    if (allocCheck) {
+#ifdef ALLOC_TRACKING
+        return runAllocCheck(detector);
+#else
+        std::cerr << "--alloc-check requires a build with -DALLOC_TRACKING" << std::endl;
+        return 1;
+#endif
+    }
+
+    bool report = !reportFormat.empty();
+    bool jsonReport = reportFormat == "json";
+    ResourceSnapshot runStart = ResourceSnapshot::take();
+
+    DecoderConfig decoderConfig;
+    decoderConfig.hugePages = hugePages;
+    decoderConfig.detector = detector;
+    decoderConfig.cfar = cfarThresholdDb.has_value();
+    if (cfarThresholdDb) decoderConfig.cfarThresholdDb = *cfarThresholdDb;
+    decoderConfig.coarseToFine = coarseConfidenceDb.has_value();
+    if (coarseConfidenceDb) decoderConfig.coarseConfidenceDb = *coarseConfidenceDb;
+    decoderConfig.excision = excision;
+    decoderConfig.clockRecovery = clockRecovery;
+
+    int status = 0;
+    if (scalingThreads > 0) {
+        status = runScalingBenchmark(scalingThreads, pinPolicy);
+    } else if (servePath) {
+        // Catch option clashes (e.g. --cfar with the tone bank) at start-up rather than on every job
+        if (const char* problem = decoderConfig.validate()) {
+            std::cerr << "Error: " << problem << std::endl;
+            status = 1;
+        } else {
+            status = DecodeDaemon(threads, decoderConfig).run(servePath);
+        }
+    } else if (psd) {
+        // Survey only: no decode, one PSD per file (CSV names follow the spectrogram rules)
+        if (filenames.empty()) filenames.push_back("test_ABC123.wav");
+        ThreadPool pool(threads);
+        for (const char* filename : filenames) {
+            PsdOptions fileOptions = *psd;
+            if (!psd->csvPath.empty()) fileOptions.csvPath = outputPathFor(psd->csvPath, filename, filenames.size() > 1, ".csv");
+            if (runPsdSurvey(filename, fileOptions, pool) != 0) status = 1;
+        }
+    } else if (hypotheses) {
+        if (filenames.empty()) filenames.push_back("test_ABC123.wav");
+        ThreadPool pool(threads);
+        for (const char* filename : filenames) {
+            if (runHypotheses(filename, decoderConfig, *hypotheses, pool) != 0) status = 1;
+        }
+    } else {
+        if (filenames.empty()) filenames.push_back("test_ABC123.wav");
+        if ((spectrogram && spectrogram->path.empty()) || (pyramid && pyramid->path.empty())) {
+            std::cerr << "--spectrogram and --pyramid need an output path" << std::endl;
+            return 1;
+        }
+        std::optional<ThreadPool> pool;
+        if (spectrogram || pyramid) pool.emplace(threads);
+        if (pipeline) pipeline->pinPolicy = pinPolicy;
+        std::optional<DetectorTuner> tuner;
+        if (autotune) tuner.emplace(detectorCache);
+        for (const char* filename : filenames) {
+            // Batch runs report each file on its own, with the peak RSS reset in between
+            bool perFile = report && filenames.size() > 1;
+            if (perFile) resetPeakRss();
+            ResourceSnapshot fileStart = ResourceSnapshot::take();
+            std::optional<SpectrogramOptions> fileSpectrogram = spectrogram;
+            if (fileSpectrogram) fileSpectrogram->path = outputPathFor(spectrogram->path, filename, filenames.size() > 1, ".png");
+            std::optional<PyramidOptions> filePyramid = pyramid;
+            if (filePyramid) filePyramid->path = outputPathFor(pyramid->path, filename, filenames.size() > 1, ".specpyr");
+            FileOutputs outputs{fileSpectrogram ? &*fileSpectrogram : nullptr, filePyramid ? &*filePyramid : nullptr,
+                                pool ? &*pool : nullptr, waterfallHz, pipeline ? &*pipeline : nullptr,
+                                mmapInput, jsonReport, tuner ? &*tuner : nullptr};
+            if (decodeFile(filename, decoderConfig, outputs) != 0) status = 1;
+            if (perFile) printResourceReport(filename, fileStart, ResourceSnapshot::take(), jsonReport);
+        }
+    }
+
+    if (report) printResourceReport("total", runStart, ResourceSnapshot::take(), jsonReport);
+    return status;
+}
@@ -0,0 +1,1063 @@
+/*
+Title: Binary FSK Tone Decoder Library
+Name: fsk_decoder.cpp
+Author: Ishan Leung
+Language: C++23
+
+Usage:
+g++ -std=c++23 -O2 -shared -fPIC -fvisibility=hidden -o libfsk_decoder.so fsk_decoder.cpp
+(or compile it straight into a program alongside its own sources)
+
+Notes:
+Implements the C++ API in fsk_decoder.hpp and the C ABI in fsk_decoder.h. No I/O, no globals.
+*/
+
+#include "fsk_decoder.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+FftPlan makeFftPlan(int n, int numaNode, bool hugePages) {
+    FftPlan plan;
+    plan.n = n;
+
+    // Factor small radices first so the generic butterfly is rarely needed
+    int remaining = n;
+    for (int radix : {4, 2, 3, 5, 7}) {
+        while (remaining % radix == 0 && remaining > 1) {
+            plan.factors.push_back(radix);
+            remaining /= radix;
+        }
+    }
+    for (int radix = 11; remaining > 1; radix += 2) {
+        while (remaining % radix == 0) {
+            plan.factors.push_back(radix);
+            remaining /= radix;
+        }
+    }
+    if (plan.factors.empty()) plan.factors.push_back(1);
+
+    plan.storage = StreamArena(StreamArena::bytesFor<Complex>(n), hugePages, numaNode);
+    plan.twiddles = plan.storage.allocate<Complex>(n);
+    for (int k = 0; k < n; k++) {
+        plan.twiddles[k] = std::polar(1.0, -2 * M_PI * k / n);
+    }
+    plan.maxFactor = *std::max_element(plan.factors.begin(), plan.factors.end());
+    return plan;
+}
+
+// Mixed-radix decimation-in-time Cooley-Tukey step, reading `in` with `stride` into `out`
+static void fftRecurse(const FftPlan& plan, const Complex* in, Complex* out, Complex* scratch,
+                       int n, int stride, const int* factor) {
+    const int p = *factor;
+    const int m = n / p;
+    const Complex* tw = plan.twiddles.data();
+
+    if (m == 1) {
+        for (int q = 0; q < p; q++) out[q] = in[q * stride];
+    } else {
+        for (int q = 0; q < p; q++) fftRecurse(plan, in + q * stride, out + q * m, scratch, m, stride * p, factor + 1);
+    }
+
+    if (p == 2) {
+        for (int k = 0; k < m; k++) {
+            Complex t = tw[k * stride] * out[k + m];
+            out[k + m] = out[k] - t;
+            out[k] += t;
+        }
+        return;
+    }
+
+    // Generic radix-p butterfly; twiddle exponents are taken modulo the full transform size
+    for (int k = 0; k < m; k++) {
+        for (int q = 0; q < p; q++) {
+            scratch[q] = tw[(long long)q * k * stride] * out[q * m + k];
+        }
+        for (int s = 0; s < p; s++) {
+            Complex sum = scratch[0];
+            for (int q = 1; q < p; q++) {
+                sum += scratch[q] * tw[((long long)q * s * m * stride) % plan.n];
+            }
+            out[k + s * m] = sum;
+        }
+    }
+}
+
+// In-place FFT of data.size() == plan.n points using plan.scratchSize() elements of scratch;
+// performs no heap allocation
+void fft(const FftPlan& plan, std::span<Complex> data, std::span<Complex> scratch) {
+    if (plan.n <= 1) return;
+    Complex* work = scratch.data();
+    fftRecurse(plan, data.data(), work, work + plan.n, plan.n, 1, plan.factors.data());
+    std::copy(work, work + plan.n, data.begin());
+}
+
+ToneBank::ToneBank(std::span<const double> tonesHz, int sampleRate, int decimation, int maxOutputs,
+                   StreamArena& arena)
+    : tones_(static_cast<int>(tonesHz.size())), decimation_(std::max(1, decimation)), maxOutputs_(maxOutputs) {
+    groups_ = arena.allocate<LaneGroup>((tones_ + kLanes - 1) / kLanes);
+    table_ = arena.allocate<int16_t>(kTableSize + kTableSize / 4);
+    power_ = arena.allocate<float>(size_t(maxOutputs_) * lanes());
+
+    for (int i = 0; i < kTableSize + kTableSize / 4; ++i) {
+        table_[i] = static_cast<int16_t>(std::lround(16384.0 * std::sin(2 * M_PI * i / kTableSize)));
+    }
+    for (int t = 0; t < tones_; ++t) {
+        double cycles = tonesHz[t] / sampleRate;  // Per sample, below 0.5
+        groups_[t / kLanes].step[t % kLanes] = static_cast<uint32_t>(std::llround(cycles * 4294967296.0));
+    }
+
+    // Mixing a full-scale tone leaves (32768 / 2) * 16384 at DC, and the CIC gains decimation^kOrder
+    double fullScale = 16384.0 * 16384.0 * std::pow(double(decimation_), kOrder);
+    normalization_ = 1.0 / (fullScale * fullScale);
+    reset();
+}
+
+size_t ToneBank::bytesFor(int tones, int maxOutputs) {
+    size_t lanes = size_t(tones + kLanes - 1) / kLanes * kLanes;
+    return StreamArena::bytesFor<LaneGroup>(lanes / kLanes) + StreamArena::bytesFor<int16_t>(kTableSize + kTableSize / 4) +
+           StreamArena::bytesFor<float>(size_t(maxOutputs) * lanes);
+}
+
+void ToneBank::reset() {
+    for (LaneGroup& group : groups_) {
+        std::fill(std::begin(group.phase), std::end(group.phase), 0u);
+        for (int stage = 0; stage < kOrder; ++stage) {
+            std::fill(std::begin(group.integI[stage]), std::end(group.integI[stage]), 0u);
+            std::fill(std::begin(group.integQ[stage]), std::end(group.integQ[stage]), 0u);
+            std::fill(std::begin(group.combI[stage]), std::end(group.combI[stage]), 0u);
+            std::fill(std::begin(group.combQ[stage]), std::end(group.combQ[stage]), 0u);
+        }
+    }
+    countdown_ = decimation_;
+    clear();
+}
+
+// The integrators wrap modulo 2^64; the combs undo the wrap exactly because a decimated output
+// (at most 2^29 * decimation^kOrder) always fits. Input runs in chunks that end at or before the
+// next decimation point: oscillator samples are looked up first, so the mix-and-integrate loop is
+// plain arithmetic across the lanes, with the integrators held in locals.
+void ToneBank::process(std::span<const int16_t> mono) {
+    const int16_t* sine = table_.data();
+    const int16_t* cosine = sine + kTableSize / 4;
+    alignas(64) int32_t oscI[kChunk][kLanes];
+    alignas(64) int32_t oscQ[kChunk][kLanes];
+    for (size_t pos = 0; pos < mono.size();) {
+        const int count = static_cast<int>(std::min<size_t>({size_t(countdown_), mono.size() - pos, size_t(kChunk)}));
+        const int16_t* x = mono.data() + pos;
+        for (LaneGroup& g : groups_) {
+            for (int k = 0; k < count; ++k) {
+                for (int l = 0; l < kLanes; ++l) {
+                    uint32_t index = g.phase[l] >> (32 - kTableBits);
+                    g.phase[l] += g.step[l];
+                    oscI[k][l] = cosine[index];
+                    oscQ[k][l] = -sine[index];
+                }
+            }
+            alignas(64) uint64_t i0[kLanes], i1[kLanes], q0[kLanes], q1[kLanes];
+            std::copy_n(g.integI[0], kLanes, i0);
+            std::copy_n(g.integI[1], kLanes, i1);
+            std::copy_n(g.integQ[0], kLanes, q0);
+            std::copy_n(g.integQ[1], kLanes, q1);
+            for (int k = 0; k < count; ++k) {
+                const int32_t sample = x[k];
+                for (int l = 0; l < kLanes; ++l) {
+                    i0[l] += static_cast<uint64_t>(int64_t(sample * oscI[k][l]));
+                    q0[l] += static_cast<uint64_t>(int64_t(sample * oscQ[k][l]));
+                    i1[l] += i0[l];
+                    q1[l] += q0[l];
+                }
+            }
+            std::copy_n(i0, kLanes, g.integI[0]);
+            std::copy_n(i1, kLanes, g.integI[1]);
+            std::copy_n(q0, kLanes, g.integQ[0]);
+            std::copy_n(q1, kLanes, g.integQ[1]);
+        }
+        pos += count;
+        framesSinceClear_ += count;
+        countdown_ -= count;
+        if (countdown_ == 0) {
+            countdown_ = decimation_;
+            emit();
+        }
+    }
+}
+
+void ToneBank::emit() {
+    if (outputs_ == maxOutputs_) return;  // Envelope full until the next clear()
+    if (outputs_ == 0) firstOutputFrame_ = framesSinceClear_ - 1;
+    float* row = power_.data() + size_t(outputs_++) * lanes();
+    for (LaneGroup& g : groups_) {
+        for (int l = 0; l < kLanes; ++l) {
+            uint64_t i = g.integI[kOrder - 1][l];
+            uint64_t q = g.integQ[kOrder - 1][l];
+            for (int stage = 0; stage < kOrder; ++stage) {
+                uint64_t inI = i, inQ = q;
+                i -= g.combI[stage][l];
+                q -= g.combQ[stage][l];
+                g.combI[stage][l] = inI;
+                g.combQ[stage][l] = inQ;
+            }
+            double re = double(static_cast<int64_t>(i));
+            double im = double(static_cast<int64_t>(q));
+            row[l] = static_cast<float>((re * re + im * im) * normalization_);
+        }
+        row += kLanes;
+    }
+}
+
+const char* DecoderConfig::validate() const {
+    if (sampleRate <= 0) return "sample rate must be positive";
+    if (channels <= 0) return "channel count must be positive";
+    if (!(symbolRate > 0) || symbolRate > sampleRate) return "symbol rate must be in (0, sample rate]";
+    if (tonePairs.empty() || tonePairs.size() > FSK_MAX_BITS) return "tone plan must have 1..FSK_MAX_BITS pairs";
+    for (const auto& [zero, one] : tonePairs) {
+        if (zero <= 0 || one <= 0 || zero >= sampleRate / 2.0 || one >= sampleRate / 2.0) {
+            return "plan tones must lie between 0 Hz and Nyquist";
+        }
+    }
+    if (!(toleranceHz > 0)) return "tolerance must be positive";
+    if (numaNode < -1) return "NUMA node must be -1 (unbound) or a node id";
+    if (detector != Detector::Fft && detector != Detector::ToneBank && detector != Detector::Goertzel) {
+        return "unknown detector";
+    }
+    if (cfar && detector == Detector::ToneBank) return "CFAR needs the FFT or Goertzel detector";
+    if (!std::isfinite(cfarThresholdDb)) return "CFAR threshold must be finite";
+    if (coarseToFine && (detector == Detector::ToneBank || cfar)) {
+        return "coarse-to-fine needs the FFT or Goertzel detector without CFAR";
+    }
+    if (excision && (detector != Detector::Fft || cfar)) return "excision needs the FFT detector without CFAR";
+    if (clockRecovery && detector != Detector::Fft) return "clock recovery needs the FFT detector";
+    if (!(coarseConfidenceDb >= 0) || !std::isfinite(coarseConfidenceDb)) return "coarse confidence must be finite and >= 0";
+    return nullptr;
+}
+
+DecoderConfig DecoderConfig::fromC(const fsk_config& c) {
+    DecoderConfig config;
+    config.sampleRate = c.sample_rate;
+    config.channels = c.channels;
+    config.symbolRate = c.symbol_rate;
+    config.tonePairs.clear();
+    for (uint32_t b = 0; b < std::min<uint32_t>(c.num_bits, FSK_MAX_BITS); ++b) {
+        config.tonePairs.emplace_back(c.tone_hz[2 * b], c.tone_hz[2 * b + 1]);
+    }
+    config.toleranceHz = c.tolerance_hz;
+    config.minSymbolFraction = c.min_symbol_fraction;
+    config.hugePages = c.huge_pages != 0;
+    config.numaNode = c.numa_node;
+    config.detector = static_cast<Detector>(c.detector);
+    config.cfar = c.cfar != 0;
+    config.cfarThresholdDb = c.cfar_threshold_db;
+    config.coarseToFine = c.coarse_to_fine != 0;
+    config.coarseConfidenceDb = c.coarse_confidence_db;
+    config.excision = c.excision != 0;
+    config.clockRecovery = c.clock_recovery != 0;
+    return config;
+}
+
+std::vector<int> detectorBins(const DecoderConfig& config) {
+    const int n = config.symbolSamples();
+    const double binsPerHz = n / double(config.sampleRate);
+    const int last = std::max(1, n / 2 - 1);  // DC and Nyquist never count as peaks
+    std::vector<int> bins;
+    for (const auto& [zero, one] : config.tonePairs) {
+        for (double freq : {zero, one}) {
+            int lo = std::clamp(static_cast<int>(std::ceil((freq - config.toleranceHz) * binsPerHz)), 1, last);
+            int hi = std::clamp(static_cast<int>(std::floor((freq + config.toleranceHz) * binsPerHz)), 1, last);
+            for (int bin = lo; bin <= hi; ++bin) bins.push_back(bin);
+            bins.push_back(std::clamp(static_cast<int>(std::lround(freq * binsPerHz)), 1, last));
+        }
+    }
+    std::sort(bins.begin(), bins.end());
+    bins.erase(std::unique(bins.begin(), bins.end()), bins.end());
+    return bins;
+}
+
+FskDecoder::FskDecoder(DecoderConfig config, SymbolCallback onSymbol, std::shared_ptr<const FftPlan> plan)
+    : config_(std::move(config)), onSymbol_(std::move(onSymbol)), symbolSamples_(config_.symbolSamples()) {
+    if (const char* problem = config_.validate()) throw std::invalid_argument(problem);
+    if (plan && plan->n != symbolSamples_) throw std::invalid_argument("shared plan does not match symbol length");
+
+    symbol_.struct_size = sizeof(FskSymbol);
+    symbol_.num_bits = static_cast<uint32_t>(config_.tonePairs.size());
+
+    if (config_.detector == Detector::ToneBank) {
+        // CIC nulls every sampleRate / decimation Hz: at twice the tolerance the passband keeps
+        // tones that far off, while tones a few tolerances away land near a null
+        int decimation = std::clamp(static_cast<int>(config_.sampleRate / (2 * config_.toleranceHz)), 1,
+                                    std::max(1, symbolSamples_ / 8));
+        int maxOutputs = symbolSamples_ / decimation + 2;
+        std::vector<double> tones;
+        for (const auto& [zero, one] : config_.tonePairs) {
+            tones.push_back(zero);
+            tones.push_back(one);
+        }
+        arena_ = StreamArena(StreamArena::bytesFor<int16_t>(kPcmBlock) + ToneBank::bytesFor(int(tones.size()), maxOutputs),
+                             config_.hugePages, config_.numaNode);
+        pcm_ = arena_.allocate<int16_t>(kPcmBlock);
+        toneBank_ = ToneBank(tones, config_.sampleRate, decimation, maxOutputs, arena_);
+        return;
+    }
+
+    // Bins near the plan tones: all that Detector::Goertzel computes, the cells CFAR reads, and
+    // the bins excision leaves alone
+    std::vector<int> toneBins;
+    if (config_.detector == Detector::Goertzel || config_.cfar || config_.excision) toneBins = detectorBins(config_);
+    const size_t numTones = 2 * config_.tonePairs.size();
+    const size_t cfarCells = std::max<size_t>(toneBins.size(), kCfarHistory);
+    const size_t coarseGroups = config_.coarseToFine ? (numTones + 3) / 4 : 0;
+    const size_t sharedBytes = StreamArena::bytesFor<int>(toneBins.size()) +
+                               (config_.cfar ? StreamArena::bytesFor<double>(numTones * kCfarHistory) +
+                                                   StreamArena::bytesFor<double>(cfarCells)
+                                             : 0) +
+                               StreamArena::bytesFor<GoertzelLanes>(coarseGroups);
+
+    if (config_.detector == Detector::Goertzel) {
+        size_t groups = (toneBins.size() + 3) / 4;
+        arena_ = StreamArena(StreamArena::bytesFor<double>(symbolSamples_) +
+                                 StreamArena::bytesFor<std::pair<double, int>>(toneBins.size()) +
+                                 StreamArena::bytesFor<GoertzelLanes>(groups) + sharedBytes,
+                             config_.hugePages, config_.numaNode);
+        samples_ = arena_.allocate<double>(symbolSamples_);
+        magnitudes_ = arena_.allocate<std::pair<double, int>>(toneBins.size());
+        goertzel_ = arena_.allocate<GoertzelLanes>(groups);
+        for (size_t i = 0; i < toneBins.size(); ++i) {
+            goertzel_[i / 4].coefficient[i % 4] = 2 * std::cos(2 * M_PI * toneBins[i] / symbolSamples_);
+        }
+    } else {
+        plan_ = plan ? std::move(plan) : std::make_shared<const FftPlan>(makeFftPlan(symbolSamples_, config_.numaNode, config_.hugePages));
+
+        size_t bins = std::max(symbolSamples_ / 2, 1);
+        size_t excisionBytes = config_.excision ? StreamArena::bytesFor<float>(bins) + StreamArena::bytesFor<uint8_t>(bins) +
+                                                      StreamArena::bytesFor<double>(bins)
+                                                : 0;
+        arena_ = StreamArena(StreamArena::bytesFor<double>(symbolSamples_) + StreamArena::bytesFor<Complex>(symbolSamples_) +
+                                 StreamArena::bytesFor<Complex>(plan_->scratchSize()) +
+                                 StreamArena::bytesFor<std::pair<double, int>>(bins) + excisionBytes + sharedBytes,
+                             config_.hugePages, config_.numaNode);
+        samples_ = arena_.allocate<double>(symbolSamples_);
+        spectrum_ = arena_.allocate<Complex>(symbolSamples_);
+        fftScratch_ = arena_.allocate<Complex>(plan_->scratchSize());
+        magnitudes_ = arena_.allocate<std::pair<double, int>>(bins);
+        if (config_.excision) {
+            lineRate_ = arena_.allocate<float>(bins);
+            planBin_ = arena_.allocate<uint8_t>(bins);
+            excisionScratch_ = arena_.allocate<double>(bins);
+            for (int bin : toneBins) planBin_[bin - 1] = 1;  // Candidates start at bin 1
+        }
+    }
+
+    bins_ = arena_.allocate<int>(toneBins.size());
+    std::copy(toneBins.begin(), toneBins.end(), bins_.begin());
+    if (config_.cfar) {
+        cfarHistory_ = arena_.allocate<double>(numTones * kCfarHistory);
+        cfarScratch_ = arena_.allocate<double>(cfarCells);
+    }
+    if (config_.coarseToFine) {
+        // Main lobe as wide as the tolerance either side, as for the tone bank's decimation, and
+        // at most a quarter of the symbol so the short path stays worth taking
+        coarseFrames_ = std::clamp(static_cast<int>(std::lround(config_.sampleRate / (2 * config_.toleranceHz))), 1,
+                                   std::max(1, symbolSamples_ / 4));
+        coarse_ = arena_.allocate<GoertzelLanes>(coarseGroups);
+        for (size_t t = 0; t < numTones; ++t) {
+            double freq = t % 2 ? config_.tonePairs[t / 2].second : config_.tonePairs[t / 2].first;
+            coarse_[t / 4].coefficient[t % 4] = 2 * std::cos(2 * M_PI * freq / config_.sampleRate);
+        }
+    }
+    if (!bins_.empty()) locateToneBins();
+}
+
+// Where each plan tone's nearest bin and tolerance window sit in bins_
+void FskDecoder::locateToneBins() {
+    const double binsPerHz = symbolSamples_ / double(config_.sampleRate);
+    const int last = std::max(1, symbolSamples_ / 2 - 1);
+    for (size_t t = 0; t < 2 * config_.tonePairs.size(); ++t) {
+        double freq = t % 2 ? config_.tonePairs[t / 2].second : config_.tonePairs[t / 2].first;
+        int nearest = std::clamp(static_cast<int>(std::lround(freq * binsPerHz)), 1, last);
+        int lo = static_cast<int>(std::ceil((freq - config_.toleranceHz) * binsPerHz));
+        int hi = static_cast<int>(std::floor((freq + config_.toleranceHz) * binsPerHz));
+        int slot = static_cast<int>(std::lower_bound(bins_.begin(), bins_.end(), nearest) - bins_.begin());
+        int begin = static_cast<int>(std::lower_bound(bins_.begin(), bins_.end(), lo) - bins_.begin());
+        int end = static_cast<int>(std::upper_bound(bins_.begin(), bins_.end(), hi) - bins_.begin());
+        toneSlots_[t] = slot;
+        toneWindows_[t] = {std::min(begin, slot), std::max(end, slot + 1)};
+    }
+}
+
+FskDecoder::Footprint FskDecoder::footprint() const {
+    Footprint footprint;
+    footprint.ioBytes = config_.detector == Detector::ToneBank ? StreamArena::bytesFor<int16_t>(kPcmBlock)
+                                                               : StreamArena::bytesFor<double>(symbolSamples_);
+    footprint.spectraBytes = arena_.used() - footprint.ioBytes;
+    footprint.planBytes = plan_ ? plan_->bytes() : 0;
+    return footprint;
+}
+
+void FskDecoder::push(std::span<const double> interleaved) { pushInterleaved(interleaved, 1.0); }
+void FskDecoder::push(std::span<const float> interleaved) { pushInterleaved(interleaved, 1.0); }
+void FskDecoder::push(std::span<const int16_t> interleaved) { pushInterleaved(interleaved, 1.0 / 32768.0); }
+
+// Average channels to mono into the symbol buffer, decoding each time it fills
+template <typename Sample>
+void FskDecoder::pushInterleaved(std::span<const Sample> interleaved, double scale) {
+    const int channels = config_.channels;
+    const size_t frames = interleaved.size() / channels;
+    const double gain = scale / channels;
+    if (config_.detector == Detector::ToneBank) {
+        // The tone bank takes 16-bit samples: averaged in integers if that is what came in,
+        // otherwise rounded and saturated
+        for (size_t i = 0; i < frames; ++i) {
+            int16_t mono;
+            if constexpr (std::is_same_v<Sample, int16_t>) {
+                int32_t sum = 0;
+                for (int ch = 0; ch < channels; ++ch) sum += interleaved[i * channels + ch];
+                mono = static_cast<int16_t>(sum / channels);
+            } else {
+                double sum = 0;
+                for (int ch = 0; ch < channels; ++ch) sum += interleaved[i * channels + ch];
+                mono = static_cast<int16_t>(std::clamp(std::lround(sum * gain * 32768.0), -32768L, 32767L));
+            }
+            pcm_[pcmFilled_++] = mono;
+            ++filled_;
+            if (pcmFilled_ == kPcmBlock) {
+                toneBank_.process(pcm_);
+                pcmFilled_ = 0;
+            }
+            if (filled_ == symbolSamples_) decodeSymbol(filled_);
+        }
+        return;
+    }
+    for (size_t i = 0; i < frames; ++i) {
+        double sum = 0;
+        for (int ch = 0; ch < channels; ++ch) sum += interleaved[i * channels + ch];
+        if (config_.clockRecovery) {
+            ++clockInputFrames_;
+            resampler_.push(sum * gain, [this](double y) { acceptSample(y); });
+        } else {
+            acceptSample(sum * gain);
+        }
+    }
+}
+
+void FskDecoder::flush() {
+    if (config_.clockRecovery) {
+        // Drain the interpolator's look-ahead; the padding is not input
+        for (int i = 0; i < FarrowResampler::kLookahead; ++i) resampler_.push(0.0, [this](double y) { acceptSample(y); });
+    }
+    if (filled_ > 0 && filled_ >= config_.minSymbolFraction * symbolSamples_) {
+        decodeSymbol(filled_);
+    } else {
+        framesConsumed_ += config_.clockRecovery ? std::exchange(clockInputFrames_, 0) : filled_;
+        filled_ = 0;
+        pcmFilled_ = 0;
+        toneBank_.clear();
+    }
+}
+
+void FskDecoder::reset() {
+    filled_ = 0;
+    pcmFilled_ = 0;
+    cfarSymbols_ = 0;
+    coarseSymbols_ = 0;
+    std::fill(lineRate_.begin(), lineRate_.end(), 0.0f);
+    resampler_ = FarrowResampler();
+    clockStep_ = 1;
+    clockSlip_ = 0;
+    clockInputFrames_ = 0;
+    symbolIndex_ = 0;
+    framesConsumed_ = 0;
+    toneBank_.reset();
+}
+
+void FskDecoder::decodeSymbol(int frames) {
+    symbol_.timing_offset_frames = 0;
+    symbol_.decision_frames = static_cast<uint32_t>(frames);
+    const bool coarse = !coarse_.empty() && decideCoarse(frames);
+    if (!coarse) {
+        switch (config_.detector) {
+            case Detector::ToneBank: detectToneBank(frames); break;
+            case Detector::Goertzel: detectGoertzel(frames); break;
+            default: detectFft(frames); break;
+        }
+    }
+    if (config_.clockRecovery) trackClock(!coarse && frames == symbolSamples_);
+
+    // With clock recovery the symbol spans however many input frames the resampler consumed
+    const int inputFrames = config_.clockRecovery ? std::exchange(clockInputFrames_, 0) : frames;
+    FskSymbol& symbol = symbol_;
+    symbol.index = symbolIndex_++;
+    symbol.first_frame = framesConsumed_;
+    symbol.frames = static_cast<uint32_t>(inputFrames);
+    symbol.clock_offset_ppm = config_.clockRecovery ? clockOffsetPpm() : 0.0;
+    framesConsumed_ += inputFrames;
+    filled_ = 0;
+
+    if (onSymbol_) onSymbol_(symbol);
+}
+
+// Transform one symbol and match its strongest peaks to the plan tones
+void FskDecoder::detectFft(int frames) {
+    const int n = symbolSamples_;
+    const double sampleRate = config_.sampleRate;
+    const int numBits = static_cast<int>(config_.tonePairs.size());
+
+    for (int i = 0; i < n; i++) {
+        spectrum_[i] = Complex(i < frames ? samples_[i] : 0.0, 0.0);  // Zero-pad a short last symbol
+    }
+    fft(*plan_, spectrum_, fftScratch_);
+
+    double toneMagnitude[2 * FSK_MAX_BITS];
+    for (int t = 0; t < 2 * numBits; ++t) {
+        const auto& [zeroHz, oneHz] = config_.tonePairs[t / 2];
+        double freq = t % 2 ? oneHz : zeroHz;
+        int bin = std::clamp(static_cast<int>(std::lround(freq * n / sampleRate)), 0, n / 2);
+        toneMagnitude[t] = std::abs(spectrum_[bin]);
+    }
+
+    // CFAR reads just the bins near the tones, in the same order Detector::Goertzel has them
+    if (config_.cfar) {
+        for (size_t i = 0; i < bins_.size(); ++i) magnitudes_[i] = {std::abs(spectrum_[bins_[i]]), bins_[i]};
+        decideCfar(toneMagnitude);
+        return;
+    }
+
+    // Every bin but DC is a candidate peak
+    size_t numBins = 0;
+    for (int i = 1; i < n / 2; ++i) {
+        magnitudes_[numBins++] = {std::abs(spectrum_[i]), i};
+    }
+    double minMagnitude = config_.excision ? exciseLines(numBins) : 0.0;
+    matchPeaks(numBins, toneMagnitude, minMagnitude);
+}
+
+// Goertzel recurrences for just the bins detectorBins() chose; the same magnitudes the transform
+// would give there, so matchPeaks() decides as for Detector::Fft whenever the strongest peaks
+// lie near plan tones. Bins run in fours so the inner loop vectorizes.
+void FskDecoder::detectGoertzel(int frames) {
+    for (GoertzelLanes& g : goertzel_) {
+        std::fill(std::begin(g.s1), std::end(g.s1), 0.0);
+        std::fill(std::begin(g.s2), std::end(g.s2), 0.0);
+    }
+    for (int i = 0; i < frames; ++i) {
+        const double x = samples_[i];
+        for (GoertzelLanes& g : goertzel_) {
+            for (int l = 0; l < 4; ++l) {
+                double s0 = x + g.coefficient[l] * g.s1[l] - g.s2[l];
+                g.s2[l] = g.s1[l];
+                g.s1[l] = s0;
+            }
+        }
+    }
+
+    const size_t numBins = magnitudes_.size();
+    for (size_t b = 0; b < numBins; ++b) {
+        const GoertzelLanes& g = goertzel_[b / 4];
+        double s1 = g.s1[b % 4], s2 = g.s2[b % 4];
+        double power = s1 * s1 + s2 * s2 - g.coefficient[b % 4] * s1 * s2;
+        magnitudes_[b] = {std::sqrt(std::max(power, 0.0)), bins_[b]};
+    }
+
+    double toneMagnitude[2 * FSK_MAX_BITS];
+    for (size_t t = 0; t < 2 * config_.tonePairs.size(); ++t) toneMagnitude[t] = magnitudes_[toneSlots_[t]].first;
+    if (config_.cfar) {
+        decideCfar(toneMagnitude);
+    } else {
+        matchPeaks(numBins, toneMagnitude);
+    }
+}
+
+// Coarse stage of coarse-to-fine detection: a Goertzel recurrence at each plan tone's exact
+// frequency over the middle coarseFrames_ samples of the symbol. Decides the symbol and returns
+// true only if every bit has a tone above kCoarsePresenceDb that beats its partner by
+// coarseConfidenceDb; otherwise leaves it to the full-length detector.
+bool FskDecoder::decideCoarse(int frames) {
+    const int m = coarseFrames_;
+    if (frames < m) return false;
+    for (GoertzelLanes& g : coarse_) {
+        std::fill(std::begin(g.s1), std::end(g.s1), 0.0);
+        std::fill(std::begin(g.s2), std::end(g.s2), 0.0);
+    }
+    const double* window = samples_.data() + (frames - m) / 2;
+    for (int i = 0; i < m; ++i) {
+        const double x = window[i];
+        for (GoertzelLanes& g : coarse_) {
+            for (int l = 0; l < 4; ++l) {
+                double s0 = x + g.coefficient[l] * g.s1[l] - g.s2[l];
+                g.s2[l] = g.s1[l];
+                g.s1[l] = s0;
+            }
+        }
+    }
+
+    const int numBits = static_cast<int>(config_.tonePairs.size());
+    double db[2 * FSK_MAX_BITS];
+    for (int t = 0; t < 2 * numBits; ++t) {
+        const GoertzelLanes& g = coarse_[t / 4];
+        double s1 = g.s1[t % 4], s2 = g.s2[t % 4];
+        double magnitude = std::sqrt(std::max(s1 * s1 + s2 * s2 - g.coefficient[t % 4] * s1 * s2, 0.0)) / (m / 2.0);
+        db[t] = 20.0 * std::log10(std::max(magnitude, 1e-9));
+    }
+    for (int b = 0; b < numBits; ++b) {
+        double winner = std::max(db[2 * b], db[2 * b + 1]);
+        double loser = std::min(db[2 * b], db[2 * b + 1]);
+        if (winner < kCoarsePresenceDb || winner - loser < config_.coarseConfidenceDb) return false;
+    }
+
+    FskSymbol& symbol = symbol_;
+    symbol.value = 0;
+    int strongest[FSK_MAX_BITS];
+    for (int b = 0; b < numBits; ++b) {
+        bool one = db[2 * b + 1] > db[2 * b];
+        symbol.bits[b] = one;
+        symbol.bit_frequency_hz[b] = one ? config_.tonePairs[b].second : config_.tonePairs[b].first;
+        if (one) symbol.value |= 1u << (numBits - 1 - b);
+        strongest[b] = 2 * b + (one ? 1 : 0);
+        symbol.tone_energy_db[2 * b] = static_cast<float>(db[2 * b]);
+        symbol.tone_energy_db[2 * b + 1] = static_cast<float>(db[2 * b + 1]);
+    }
+
+    // The winning tones stand in for spectral peaks
+    std::sort(strongest, strongest + numBits, [&](int a, int b) { return db[a] > db[b]; });
+    std::fill(std::begin(symbol.peak_frequency_hz), std::end(symbol.peak_frequency_hz), 0.0);
+    for (int i = 0; i < numBits; ++i) symbol.peak_frequency_hz[i] = symbol.bit_frequency_hz[strongest[i] / 2];
+    symbol.decision_frames = static_cast<uint32_t>(m);
+    ++coarseSymbols_;
+    return true;
+}
+
+// Take the strongest of `candidates` (magnitude, bin) pairs in magnitudes_ and match them to the
+// plan: each bit takes the value of whichever of its two tones has the closest peak within the
+// tolerance, else 0. `toneMagnitude` is |X| at each plan tone's nearest bin, for tone_energy_db.
+// Peaks weaker than `minMagnitude` are not peaks at all.
+void FskDecoder::matchPeaks(size_t candidates, const double* toneMagnitude, double minMagnitude) {
+    const int n = symbolSamples_;
+    const double sampleRate = config_.sampleRate;
+    const int numBits = static_cast<int>(config_.tonePairs.size());
+
+    // Only the top numBits need ordering
+    size_t count = std::min<size_t>(numBits, candidates);
+    std::partial_sort(magnitudes_.begin(), magnitudes_.begin() + count, magnitudes_.begin() + candidates,
+                      std::greater<>());
+    while (count > 0 && magnitudes_[count - 1].first < minMagnitude) --count;
+
+    FskSymbol& symbol = symbol_;
+    std::fill(std::begin(symbol.peak_frequency_hz), std::end(symbol.peak_frequency_hz), 0.0);
+    for (size_t i = 0; i < count; ++i) {
+        symbol.peak_frequency_hz[i] = (magnitudes_[i].second * sampleRate) / n;
+    }
+
+    symbol.value = 0;
+    for (int b = 0; b < numBits; ++b) {
+        const auto& [zeroHz, oneHz] = config_.tonePairs[b];
+        bool one = false;
+        double closestFreq = 0.0;
+        double minDiff = config_.toleranceHz;
+        for (size_t i = 0; i < count; ++i) {
+            double freq = symbol.peak_frequency_hz[i];
+            double diff0 = std::abs(freq - zeroHz);
+            double diff1 = std::abs(freq - oneHz);
+            if (diff0 < minDiff) {
+                one = false;
+                minDiff = diff0;
+                closestFreq = freq;
+            }
+            if (diff1 < minDiff) {
+                one = true;
+                minDiff = diff1;
+                closestFreq = freq;
+            }
+        }
+        symbol.bits[b] = one;
+        symbol.bit_frequency_hz[b] = closestFreq;
+        if (one) symbol.value |= 1u << (numBits - 1 - b);
+
+        // Tone energies relative to a full-scale sine, which peaks at |X| = n / 2
+        for (int value = 0; value < 2; ++value) {
+            double magnitude = toneMagnitude[2 * b + value] / (n / 2.0);
+            symbol.tone_energy_db[2 * b + value] = static_cast<float>(20.0 * std::log10(std::max(magnitude, 1e-9)));
+        }
+    }
+}
+
+namespace {
+
+// Median of `count` values, reordering them
+double medianOf(double* values, size_t count) {
+    std::nth_element(values, values + count / 2, values + count);
+    return values[count / 2];
+}
+
+}  // namespace
+
+// Ordered-statistic CFAR. Each plan tone's signal is its strongest bin within tolerance; its
+// noise is the median power of the other bins within tolerance, kCfarGuardBins either side of the
+// peak left out, and its floor the median of that estimate over the last kCfarHistory symbols, so
+// one burst neither hides a tone nor invents one. A peak on the edge of the window is leakage from
+// a signal outside it and counts as nothing, as does one below kMinimumPeakDb, where a quiet
+// floor would otherwise promote quantization products to tones. A bit takes whichever of its tones stands
+// further above its floor, provided one clears cfarThresholdDb; otherwise it reads 0.
+void FskDecoder::decideCfar(const double* toneMagnitude) {
+    const int n = symbolSamples_;
+    const double sampleRate = config_.sampleRate;
+    const int numBits = static_cast<int>(config_.tonePairs.size());
+    const double threshold = std::pow(10.0, config_.cfarThresholdDb / 10.0);
+    const int slot = cfarSymbols_ % kCfarHistory;
+    const int history = std::min(cfarSymbols_ + 1, kCfarHistory);
+    const double minimumMagnitude = std::pow(10.0, kMinimumPeakDb / 20.0) * (n / 2.0);
+    ++cfarSymbols_;
+
+    double snr[2 * FSK_MAX_BITS];
+    int peakBin[2 * FSK_MAX_BITS];
+    double* cells = cfarScratch_.data();
+    for (int t = 0; t < 2 * numBits; ++t) {
+        const auto [begin, end] = toneWindows_[t];
+        int peak = begin;
+        for (int i = begin; i < end; ++i) {
+            if (magnitudes_[i].first > magnitudes_[peak].first) peak = i;
+        }
+        peakBin[t] = bins_[peak];
+        // A peak on the window's edge is the skirt of something outside it, not this tone
+        const bool edge = end - begin >= 3 && (peak == begin || peak == end - 1);
+        const bool audible = magnitudes_[peak].first >= minimumMagnitude;
+        const double signal = edge || !audible ? 0.0 : magnitudes_[peak].first * magnitudes_[peak].first;
+
+        size_t count = 0;
+        auto gather = [&](size_t from, size_t to) {
+            for (size_t i = from; i < to; ++i) {
+                if (std::abs(bins_[i] - peakBin[t]) > kCfarGuardBins) cells[count++] = magnitudes_[i].first * magnitudes_[i].first;
+            }
+        };
+        gather(begin, end);
+        if (count < kCfarMinCells) {
+            count = 0;
+            gather(0, bins_.size());
+        }
+        double* past = cfarHistory_.data() + size_t(t) * kCfarHistory;
+        past[slot] = count ? medianOf(cells, count) : 0.0;
+        std::copy_n(past, history, cells);
+        const double floor = medianOf(cells, history);
+        snr[t] = floor > 0 ? signal / floor : (signal > 0 ? threshold : 0.0);
+    }
+
+    FskSymbol& symbol = symbol_;
+    symbol.value = 0;
+    int detected[FSK_MAX_BITS];
+    int numDetected = 0;
+    for (int b = 0; b < numBits; ++b) {
+        bool one = snr[2 * b + 1] > snr[2 * b];
+        int winner = 2 * b + (one ? 1 : 0);
+        bool present = snr[winner] >= threshold;
+        one = one && present;
+        symbol.bits[b] = one;
+        symbol.bit_frequency_hz[b] = present ? peakBin[winner] * sampleRate / n : 0.0;
+        if (one) symbol.value |= 1u << (numBits - 1 - b);
+        if (present) detected[numDetected++] = winner;
+
+        for (int value = 0; value < 2; ++value) {
+            double magnitude = toneMagnitude[2 * b + value] / (n / 2.0);
+            symbol.tone_energy_db[2 * b + value] = static_cast<float>(20.0 * std::log10(std::max(magnitude, 1e-9)));
+        }
+    }
+
+    // Detected tones stand in for the strongest peaks, furthest above their floors first
+    std::sort(detected, detected + numDetected, [&](int a, int b) { return snr[a] > snr[b]; });
+    std::fill(std::begin(symbol.peak_frequency_hz), std::end(symbol.peak_frequency_hz), 0.0);
+    for (int i = 0; i < numDetected; ++i) symbol.peak_frequency_hz[i] = peakBin[detected[i]] * sampleRate / n;
+}
+
+// Narrowband interference excision over the `candidates` bins in magnitudes_, still in bin order.
+// Each bin keeps an exponentially weighted rate of symbols in which it stood kExcisionDb above the
+// median bin; an off-plan bin whose rate reaches kExcisionPersistence carries a steady line and is
+// set to the median, here and in spectrum_. A line is masked from its second symbol on, a one-off
+// burst never, and the work per symbol is a selection and one pass over the bins. Returns the lit
+// level, or kMinimumPeakDb if higher: with the lines gone the strongest bins left may be the
+// floor's own, or quantization products, which must not count.
+double FskDecoder::exciseLines(size_t candidates) {
+    double* scratch = excisionScratch_.data();
+    for (size_t i = 0; i < candidates; ++i) scratch[i] = magnitudes_[i].first;
+    const double median = candidates ? medianOf(scratch, candidates) : 0.0;
+    const double lit = median * std::pow(10.0, kExcisionDb / 20.0);
+
+    excisedBins_ = 0;
+    for (size_t i = 0; i < candidates; ++i) {
+        auto& [magnitude, bin] = magnitudes_[i];
+        float& rate = lineRate_[i];
+        rate += kExcisionRate * ((magnitude > lit ? 1.0f : 0.0f) - rate);
+        if (rate < kExcisionPersistence || planBin_[i] || magnitude <= median) continue;
+        spectrum_[bin] *= median / magnitude;
+        spectrum_[symbolSamples_ - bin] = std::conj(spectrum_[bin]);
+        magnitude = median;
+        ++excisedBins_;
+    }
+    return std::max(lit, std::pow(10.0, kMinimumPeakDb / 20.0) * (symbolSamples_ / 2.0));
+}
+
+// Clock recovery, after a symbol has been decided. A recorder clock offset scales every tone by
+// the same ratio, so each decided tone's peak is located to a fraction of a bin (Quinn's first
+// estimator, exact for one tone in a rectangular window) and the ratio fitted through the origin
+// across tones, weighting high tones as they resolve it best. That ratio says how many input
+// samples this symbol should have taken. The rate estimate moves kClockLoopGain of the way towards
+// it, the boundary slip the wrong rate caused is accumulated, and the resampler's next step is set
+// to the estimate plus whatever removes the slip over the next symbol. `measurable` is false for
+// symbols without a full transform; the estimate then carries on unchanged.
+void FskDecoder::trackClock(bool measurable) {
+    const int n = symbolSamples_;
+    const double sampleRate = config_.sampleRate;
+    const double minimumMagnitude = std::pow(10.0, kMinimumPeakDb / 20.0) * (n / 2.0);
+    const double used = resampler_.step();
+
+    double fit = 0, weight = 0;
+    for (size_t b = 0; measurable && b < config_.tonePairs.size(); ++b) {
+        if (symbol_.bit_frequency_hz[b] <= 0) continue;
+        const double planHz = symbol_.bits[b] ? config_.tonePairs[b].second : config_.tonePairs[b].first;
+        const int k = static_cast<int>(std::lround(symbol_.bit_frequency_hz[b] * n / sampleRate));
+        if (k < 1 || k + 1 >= n / 2 || std::abs(spectrum_[k]) < minimumMagnitude) continue;
+        const double before = (spectrum_[k - 1] / spectrum_[k]).real();
+        const double after = (spectrum_[k + 1] / spectrum_[k]).real();
+        const double below = before / (1 - before);
+        const double above = -after / (1 - after);
+        const double delta = below > 0 && above > 0 ? above : below;
+        fit += (k + delta) * sampleRate / n * planHz;
+        weight += planHz * planHz;
+    }
+
+    double measured = clockStep_;
+    if (weight > 0) {
+        const double ratio = std::clamp(fit / weight, 1 - kMaxClockPpm * 1e-6, 1 + kMaxClockPpm * 1e-6);
+        measured = used / ratio;
+        clockStep_ += kClockLoopGain * (measured - clockStep_);
+    }
+    clockSlip_ += n * (measured - used);
+    resampler_.setStep(clockStep_ + clockSlip_ / n);
+}
+
+// A bit is 1 when its 1-tone is present and stronger than its 0-tone, mirroring the FFT rule that a
+// bit without a matching peak reads 0; present means above -60 dBFS and within 30 dB of the
+// strongest plan tone, so silence and off-plan signals decode as zeros. The first kOrder envelope
+// samples still straddle the previous symbol and are left out of the energies.
+// Per envelope sample decisions locate the boundary: a run of leading samples that decode like a
+// different symbol means it began later than assumed, a trailing run that the next one began early.
+void FskDecoder::detectToneBank(int frames) {
+    if (pcmFilled_ > 0) toneBank_.process(pcm_.first(pcmFilled_));
+    pcmFilled_ = 0;
+
+    const ToneBank& bank = toneBank_;
+    const int numBits = static_cast<int>(config_.tonePairs.size());
+    const int outputs = bank.outputs();
+    const int skip = outputs > ToneBank::kOrder ? ToneBank::kOrder : 0;
+
+    FskSymbol& symbol = symbol_;
+    double energy[2 * FSK_MAX_BITS] = {};
+    for (int k = skip; k < outputs; ++k) {
+        for (int t = 0; t < 2 * numBits; ++t) energy[t] += bank.power(k, t);
+    }
+    int strongest[2 * FSK_MAX_BITS];
+    for (int t = 0; t < 2 * numBits; ++t) {
+        energy[t] /= std::max(1, outputs - skip);
+        symbol.tone_energy_db[t] = static_cast<float>(10.0 * std::log10(std::max(energy[t], 1e-18)));
+        strongest[t] = t;
+    }
+
+    const double floor = std::max(1e-6, *std::max_element(energy, energy + 2 * numBits) * 1e-3);
+    auto isOne = [floor](double zero, double one) { return one > zero && one > floor; };
+
+    symbol.value = 0;
+    for (int b = 0; b < numBits; ++b) {
+        bool one = isOne(energy[2 * b], energy[2 * b + 1]);
+        symbol.bits[b] = one;
+        symbol.bit_frequency_hz[b] = one ? config_.tonePairs[b].second : config_.tonePairs[b].first;
+        if (one) symbol.value |= 1u << (numBits - 1 - b);
+    }
+
+    // Strongest tones stand in for spectral peaks
+    std::partial_sort(strongest, strongest + numBits, strongest + 2 * numBits,
+                      [&](int a, int b) { return energy[a] > energy[b]; });
+    std::fill(std::begin(symbol.peak_frequency_hz), std::end(symbol.peak_frequency_hz), 0.0);
+    for (int i = 0; i < numBits; ++i) {
+        const auto& pair = config_.tonePairs[strongest[i] / 2];
+        symbol.peak_frequency_hz[i] = strongest[i] % 2 ? pair.second : pair.first;
+    }
+
+    if (floor == 1e-6) {  // No plan tone present: nothing to time
+        toneBank_.clear();
+        return;
+    }
+    auto decodesAsSymbol = [&](int k) {
+        for (int b = 0; b < numBits; ++b) {
+            if (isOne(bank.power(k, 2 * b), bank.power(k, 2 * b + 1)) != bool(symbol.bits[b])) return false;
+        }
+        return true;
+    };
+    int leading = 0;
+    while (leading < outputs && !decodesAsSymbol(leading)) ++leading;
+    int trailing = 0;
+    while (trailing < outputs - leading && !decodesAsSymbol(outputs - 1 - trailing)) ++trailing;
+    if (leading > 0 && leading < outputs) {
+        symbol.timing_offset_frames = static_cast<int32_t>(
+            std::lround((bank.outputCentre(leading - 1) + bank.outputCentre(leading)) / 2));
+    } else if (trailing > 0 && trailing < outputs) {
+        int first = outputs - trailing;
+        symbol.timing_offset_frames = static_cast<int32_t>(
+            std::lround((bank.outputCentre(first - 1) + bank.outputCentre(first)) / 2 - frames));
+    }
+    toneBank_.clear();
+}
+
+// C ABI: thin, exception-free wrappers around FskDecoder
+
+struct fsk_decoder {
+    std::unique_ptr<FskDecoder> impl;
+};
+
+namespace {
+
+template <typename Fn>
+int guarded(fsk_decoder* decoder, Fn&& fn) {
+    if (!decoder) return FSK_ERR_INVALID_ARGUMENT;
+    try {
+        fn(*decoder->impl);
+        return FSK_OK;
+    } catch (const std::bad_alloc&) {
+        return FSK_ERR_NO_MEMORY;
+    } catch (...) {
+        return FSK_ERR_INTERNAL;
+    }
+}
+
+static_assert(sizeof(void*) != 8 || sizeof(fsk_config) == FSK_CONFIG_SIZE_V2,
+              "appending to fsk_config needs a new FSK_CONFIG_SIZE_V* and ABI version");
+
+// Every field of the current layout at its DecoderConfig default
+void fillDefaults(fsk_config& config) {
+    DecoderConfig defaults;
+    config.struct_size = sizeof(config);
+    config.sample_rate = defaults.sampleRate;
+    config.channels = defaults.channels;
+    config.symbol_rate = defaults.symbolRate;
+    config.num_bits = static_cast<uint32_t>(defaults.tonePairs.size());
+    for (size_t b = 0; b < defaults.tonePairs.size(); ++b) {
+        config.tone_hz[2 * b] = defaults.tonePairs[b].first;
+        config.tone_hz[2 * b + 1] = defaults.tonePairs[b].second;
+    }
+    config.tolerance_hz = defaults.toleranceHz;
+    config.min_symbol_fraction = defaults.minSymbolFraction;
+    config.huge_pages = defaults.hugePages;
+    config.numa_node = defaults.numaNode;
+    config.detector = static_cast<int32_t>(defaults.detector);
+    config.cfar = defaults.cfar;
+    config.cfar_threshold_db = defaults.cfarThresholdDb;
+    config.coarse_to_fine = defaults.coarseToFine;
+    config.coarse_confidence_db = defaults.coarseConfidenceDb;
+    config.excision = defaults.excision;
+    config.clock_recovery = defaults.clockRecovery;
+}
+
+// Copy the fields a caller's struct really has, one by one: its size picks the ABI version, and
+// padding is never read, since in one version it may sit where the next one put a field
+bool readConfig(const fsk_config& config, fsk_config& full) {
+    const size_t size = config.struct_size;
+    if (size != FSK_CONFIG_SIZE_V1 && size < FSK_CONFIG_SIZE_V2) return false;  // No such version
+    std::memset(&full, 0, sizeof(full));
+    fillDefaults(full);
+    full.sample_rate = config.sample_rate;
+    full.channels = config.channels;
+    full.symbol_rate = config.symbol_rate;
+    full.num_bits = config.num_bits;
+    std::copy(std::begin(config.tone_hz), std::end(config.tone_hz), full.tone_hz);
+    full.tolerance_hz = config.tolerance_hz;
+    full.min_symbol_fraction = config.min_symbol_fraction;
+    full.huge_pages = config.huge_pages;
+    if (size < FSK_CONFIG_SIZE_V2) return true;
+    full.numa_node = config.numa_node;
+    full.detector = config.detector;
+    full.cfar = config.cfar;
+    full.cfar_threshold_db = config.cfar_threshold_db;
+    full.coarse_to_fine = config.coarse_to_fine;
+    full.coarse_confidence_db = config.coarse_confidence_db;
+    full.excision = config.excision;
+    full.clock_recovery = config.clock_recovery;
+    return true;
+}
+
+fsk_decoder* createDecoder(const fsk_config* config, const fsk_decoder* sharePlanWith, fsk_symbol_callback callback,
+                           void* userData) {
+    // Older callers may pass a shorter struct; fields it lacks keep their defaults
+    fsk_config full;
+    if (!config || !readConfig(*config, full)) return nullptr;
+    try {
+        std::shared_ptr<const FftPlan> plan;
+        DecoderConfig decoderConfig = DecoderConfig::fromC(full);
+        if (sharePlanWith && sharePlanWith->impl->plan() && decoderConfig.detector == Detector::Fft &&
+            sharePlanWith->impl->plan()->n == decoderConfig.symbolSamples()) {
+            plan = sharePlanWith->impl->plan();
+        }
+        auto onSymbol = [callback, userData](const FskSymbol& symbol) {
+            if (callback) callback(userData, &symbol);
+        };
+        return new fsk_decoder{std::make_unique<FskDecoder>(std::move(decoderConfig), onSymbol, std::move(plan))};
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+}  // namespace
+
+extern "C" {
+
+uint32_t fsk_decoder_abi_version(void) { return FSK_DECODER_ABI_VERSION; }
+
+void fsk_config_init_sized(fsk_config* config, size_t size) {
+    if (!config || size < FSK_CONFIG_SIZE_V1) return;
+    // Build the defaults aside and copy out only what the caller's struct can hold
+    fsk_config full;
+    std::memset(&full, 0, sizeof(full));
+    fillDefaults(full);
+    std::memset(config, 0, size);
+    std::memcpy(config, &full, std::min(size, sizeof(full)));
+    config->struct_size = static_cast<uint32_t>(size >= FSK_CONFIG_SIZE_V2 ? FSK_CONFIG_SIZE_V2 : FSK_CONFIG_SIZE_V1);
+}
+
+void(fsk_config_init)(fsk_config* config) { fsk_config_init_sized(config, FSK_CONFIG_SIZE_V1); }
+
+fsk_decoder* fsk_decoder_create(const fsk_config* config, fsk_symbol_callback callback, void* user_data) {
+    return createDecoder(config, nullptr, callback, user_data);
+}
+
+fsk_decoder* fsk_decoder_create_shared(const fsk_config* config, const fsk_decoder* share_plan_with,
+                                       fsk_symbol_callback callback, void* user_data) {
+    return createDecoder(config, share_plan_with, callback, user_data);
+}
+
+void fsk_decoder_destroy(fsk_decoder* decoder) { delete decoder; }
+
+int fsk_decoder_push_f64(fsk_decoder* decoder, const double* interleaved, size_t frames) {
+    if (!interleaved && frames) return FSK_ERR_INVALID_ARGUMENT;
+    return guarded(decoder, [&](FskDecoder& d) {
+        d.push(std::span<const double>(interleaved, frames * d.config().channels));
+    });
+}
+
+int fsk_decoder_push_f32(fsk_decoder* decoder, const float* interleaved, size_t frames) {
+    if (!interleaved && frames) return FSK_ERR_INVALID_ARGUMENT;
+    return guarded(decoder, [&](FskDecoder& d) {
+        d.push(std::span<const float>(interleaved, frames * d.config().channels));
+    });
+}
+
+int fsk_decoder_push_s16(fsk_decoder* decoder, const int16_t* interleaved, size_t frames) {
+    if (!interleaved && frames) return FSK_ERR_INVALID_ARGUMENT;
+    return guarded(decoder, [&](FskDecoder& d) {
+        d.push(std::span<const int16_t>(interleaved, frames * d.config().channels));
+    });
+}
+
+int fsk_decoder_flush(fsk_decoder* decoder) {
+    return guarded(decoder, [](FskDecoder& d) { d.flush(); });
+}
+
+int fsk_decoder_reset(fsk_decoder* decoder) {
+    return guarded(decoder, [](FskDecoder& d) { d.reset(); });
+}
+
+}  // extern "C"
@@ -0,0 +1,141 @@
+/*
+Title: Binary FSK Tone Decoder Library, C ABI
+Name: fsk_decoder.h
+Author: Ishan Leung
+Language: C (C99 and later; C++ callers may use fsk_decoder.hpp instead)
+
+Usage:
+g++ -std=c++23 -O2 -shared -fPIC -fvisibility=hidden -o libfsk_decoder.so fsk_decoder.cpp
+cc -o my_service my_service.c -L. -lfsk_decoder
+
+Notes:
+- A decoder is configured from a tone plan and a stream format, is fed samples with
+  fsk_decoder_push_*(), and reports each decoded symbol through a callback. It does no I/O and
+  touches no global state, so any number of decoders may run concurrently, one thread each.
+- Structs carry struct_size so fields can be appended without breaking the ABI; set it with
+  fsk_config_init() and check FSK_DECODER_ABI_VERSION against fsk_decoder_abi_version().
+  struct_size must be one of the FSK_CONFIG_SIZE_V* layouts (or larger than the newest); the
+  library reads only the fields that layout has and defaults the rest.
+- Functions never throw or abort; they return FSK_OK or a negative fsk_status.
+*/
+
+#ifndef FSK_DECODER_H
+#define FSK_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define FSK_API __attribute__((visibility("default")))
+#else
+#define FSK_API
+#endif
+
+#define FSK_DECODER_ABI_VERSION 2
+
+/* sizeof(fsk_config) in each ABI version on LP64 targets. Every version appends fields and must grow the struct:
+   a field placed in the previous version's tail padding could not be told apart from it. */
+#define FSK_CONFIG_SIZE_V1 568  /* Through huge_pages */
+#define FSK_CONFIG_SIZE_V2 608  /* Through clock_recovery */
+#define FSK_MAX_BITS 32
+
+typedef enum fsk_detector {
+    FSK_DETECTOR_FFT = 0,        /* Transform each symbol and match spectral peaks to the plan */
+    FSK_DETECTOR_TONE_BANK = 1,  /* Mix each tone to baseband and compare CIC-filtered energies */
+    FSK_DETECTOR_GOERTZEL = 2    /* Like FFT, but evaluate only the bins within tolerance of a tone */
+} fsk_detector;
+
+typedef enum fsk_status {
+    FSK_OK = 0,
+    FSK_ERR_INVALID_ARGUMENT = -1,
+    FSK_ERR_NO_MEMORY = -2,
+    FSK_ERR_INTERNAL = -3
+} fsk_status;
+
+/* Stream format and tone plan. Bit b is sent as tone_hz[2b] for 0 and tone_hz[2b + 1] for 1;
+   bit 0 is the most significant bit of the symbol value. */
+typedef struct fsk_config {
+    uint32_t struct_size;
+    int32_t sample_rate;         /* Frames per second */
+    int32_t channels;            /* Interleaved channels, averaged to mono */
+    double symbol_rate;          /* Symbols per second */
+    uint32_t num_bits;           /* Bits per symbol, 1..FSK_MAX_BITS */
+    double tone_hz[2 * FSK_MAX_BITS];
+    double tolerance_hz;         /* Peaks further than this from a tone are ignored */
+    double min_symbol_fraction;  /* A trailing partial symbol shorter than this is dropped */
+    int32_t huge_pages;          /* Non-zero: back scratch memory with 2 MiB pages if possible */
+    int32_t numa_node;           /* Place buffers and plan on this NUMA node; -1 for first touch */
+    int32_t detector;            /* An fsk_detector */
+    int32_t cfar;                /* Non-zero: decide bits against a tracked noise floor (FFT and Goertzel) */
+    double cfar_threshold_db;    /* How far above its floor a tone must stand to count */
+    int32_t coarse_to_fine;      /* Non-zero: try a short window first (FFT and Goertzel, not with cfar) */
+    double coarse_confidence_db; /* Margin every bit's winning tone needs for the short window to decide */
+    int32_t excision;            /* Non-zero: mask persistent off-plan lines before peak matching (FFT only) */
+    int32_t clock_recovery;      /* Non-zero: estimate the recorder's sample-clock offset and resample (FFT only) */
+} fsk_config;
+
+/* One decoded symbol */
+typedef struct fsk_symbol {
+    uint32_t struct_size;
+    uint32_t num_bits;
+    uint64_t index;                          /* Symbols since create or reset */
+    uint64_t first_frame;                    /* Stream position of the symbol's first frame */
+    uint32_t frames;                         /* Input frames; fewer than a full symbol only at the end */
+    uint32_t value;                          /* Bits packed, bit 0 most significant */
+    uint8_t bits[FSK_MAX_BITS];
+    double bit_frequency_hz[FSK_MAX_BITS];   /* Peak that decided each bit, 0 when none matched */
+    double peak_frequency_hz[FSK_MAX_BITS];  /* Strongest spectral peaks, strongest first */
+    float tone_energy_db[2 * FSK_MAX_BITS];  /* Per plan tone, dB relative to a full-scale tone */
+    int32_t timing_offset_frames;            /* Where the symbol really began relative to first_frame,
+                                                as far as the detector can tell; 0 if it cannot */
+    uint32_t decision_frames;                /* Frames the bits were decided from: all of them, or the
+                                                short window of a coarse-to-fine decoder */
+    double clock_offset_ppm;                 /* Sample-clock offset being corrected, positive when the
+                                                recorder's clock runs fast; 0 without clock_recovery */
+} fsk_symbol;
+
+typedef struct fsk_decoder fsk_decoder;
+
+/* Called once per symbol, on the thread that pushed the samples completing it */
+typedef void (*fsk_symbol_callback)(void* user_data, const fsk_symbol* symbol);
+
+FSK_API uint32_t fsk_decoder_abi_version(void);
+
+/* Fill the first `size` bytes of *config with the default 8-bit plan (300/500 Hz ... 3100/3300 Hz),
+   44.1 kHz mono, 1 symbol/s; the fsk_config_init() macro passes the caller's sizeof */
+FSK_API void fsk_config_init_sized(fsk_config* config, size_t size);
+#define fsk_config_init(config) fsk_config_init_sized((config), sizeof(*(config)))
+
+/* The ABI 1 entry point, kept for binaries built against it: fills FSK_CONFIG_SIZE_V1 bytes */
+FSK_API void (fsk_config_init)(fsk_config* config);
+
+/* Returns NULL if the configuration is invalid or memory is exhausted */
+FSK_API fsk_decoder* fsk_decoder_create(const fsk_config* config, fsk_symbol_callback callback, void* user_data);
+
+/* Like fsk_decoder_create, but shares the read-only transform plan of `share_plan_with` when the
+   symbol length matches, so thousands of identical decoders hold one plan between them */
+FSK_API fsk_decoder* fsk_decoder_create_shared(const fsk_config* config, const fsk_decoder* share_plan_with,
+                                               fsk_symbol_callback callback, void* user_data);
+
+FSK_API void fsk_decoder_destroy(fsk_decoder* decoder);
+
+/* Append interleaved frames; the callback runs for every symbol they complete */
+FSK_API int fsk_decoder_push_f64(fsk_decoder* decoder, const double* interleaved, size_t frames);
+FSK_API int fsk_decoder_push_f32(fsk_decoder* decoder, const float* interleaved, size_t frames);
+FSK_API int fsk_decoder_push_s16(fsk_decoder* decoder, const int16_t* interleaved, size_t frames);
+
+/* Decode a trailing partial symbol (zero-padded) if it is long enough; call at end of stream */
+FSK_API int fsk_decoder_flush(fsk_decoder* decoder);
+
+/* Discard buffered samples and restart symbol numbering */
+FSK_API int fsk_decoder_reset(fsk_decoder* decoder);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FSK_DECODER_H */
@@ -0,0 +1,486 @@
+/*
+Title: Binary FSK Tone Decoder Library, C++ API
+Name: fsk_decoder.hpp
+Author: Ishan Leung
+Language: C++23
+
+Usage:
+#include "fsk_decoder.hpp" and compile fsk_decoder.cpp into the program or link libfsk_decoder.so.
+
+Notes:
+- FskDecoder holds all of its state; nothing in the library is global, so decoders are fully
+  reentrant and one thread per decoder needs no locking.
+- After construction a decoder does not allocate: samples, transform scratch and peak lists live
+  in one StreamArena sized from the symbol length.
+- Three detectors: Detector::Fft transforms each symbol and matches its strongest peaks to the
+  plan; Detector::Goertzel applies the same rule to just the bins within tolerance of a plan
+  tone, each computed by a Goertzel recurrence (cheaper than a transform when symbols are short
+  or tones few); Detector::ToneBank mixes every plan tone to baseband and low-passes it with a
+  CIC decimator, in integer arithmetic on 16-bit samples, and compares tone energies. The tone
+  bank's envelopes also place the symbol boundary, reported as timing_offset_frames. Which is
+  fastest depends on the stream; see detectorBins() for the Goertzel workload.
+- With DecoderConfig::cfar the FFT and Goertzel detectors stop ranking peaks across the whole
+  band and judge each plan tone against its own noise floor, tracked over neighbouring bins and
+  over time, so strong off-plan interferers cannot crowd tones out.
+- With DecoderConfig::excision the FFT detector tracks which off-plan bins carry a line symbol
+  after symbol (hum harmonics, whistles) and sets them to the median level before picking the
+  strongest peaks, so a steady interferer cannot take a tone's place among them.
+- With DecoderConfig::clockRecovery the FFT detector measures where the decided tones really sit,
+  to a fraction of a bin, and so how fast the recorder's clock ran against sampleRate; a Farrow
+  resampler in front of the symbol buffer is steered to undo the offset and the boundary slip it
+  has already caused, so long recordings from another device stay aligned.
+- With DecoderConfig::coarseToFine the FFT and Goertzel detectors first look at a short window
+  from the middle of the symbol, at the plan frequencies only, and run the full-length detector
+  just for symbols where some bit is not clear-cut there. Clean streams then cost little more
+  than the short window per symbol; doubtful symbols are decided exactly as without it.
+- The transform engine (FftPlan, fft), ToneBank and StreamArena are exported for tools built on top.
+- The stable, versioned C ABI is in fsk_decoder.h; symbols are reported as its fsk_symbol.
+*/
+
+#pragma once
+
+#include "fsk_decoder.h"
+
+#include <algorithm>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using Complex = std::complex<double>;
+using CArray = std::vector<Complex>;
+
+// Per-stream bump arena: one 64-byte aligned block carved into typed spans for each stage.
+// Everything is sized up front from the chunk length, so streams never touch the shared heap
+// while decoding and their footprint is known before the first read.
+class StreamArena {
+public:
+    static constexpr size_t kAlignment = 64;
+    static constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+
+    StreamArena() = default;
+
+    // `numaNode` >= 0 maps the block and asks the kernel to place its pages on that node
+    // (preferred, not strict), whichever thread touches them first
+    StreamArena(size_t capacity, bool hugePages, int numaNode = -1) {
+        capacity_ = roundUp(capacity ? capacity : kAlignment, kAlignment);
+        if (hugePages || numaNode >= 0) {
+            // Explicit huge pages first, then transparent huge pages, then plain pages
+            size_t granule = hugePages ? kHugePageSize : size_t(sysconf(_SC_PAGESIZE));
+            size_t mapped = roundUp(capacity_, granule);
+            void* p = MAP_FAILED;
+            if (hugePages) {
+                p = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+                hugePages_ = p != MAP_FAILED;
+            }
+            if (p == MAP_FAILED && hugePages) {
+                // Transparent huge pages only back 2 MiB-aligned extents, so align the block
+                p = mmap(nullptr, mapped + kHugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (p != MAP_FAILED) {
+                    auto raw = reinterpret_cast<uintptr_t>(p);
+                    uintptr_t aligned = roundUp(raw, kHugePageSize);
+                    if (aligned > raw) munmap(p, aligned - raw);
+                    munmap(reinterpret_cast<void*>(aligned + mapped), raw + kHugePageSize - aligned);
+                    p = reinterpret_cast<void*>(aligned);
+                    madvise(p, mapped, MADV_HUGEPAGE);
+                }
+            }
+            if (p == MAP_FAILED) {
+                p = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            }
+            if (p != MAP_FAILED) {
+                base_ = static_cast<std::byte*>(p);
+                capacity_ = mapped;
+                mapped_ = true;
+                if (numaNode >= 0) numaNode_ = bindToNode(p, mapped, numaNode) ? numaNode : -1;
+                return;
+            }
+        }
+        base_ = static_cast<std::byte*>(std::aligned_alloc(kAlignment, capacity_));
+        if (!base_) throw std::bad_alloc();
+    }
+
+    StreamArena(const StreamArena&) = delete;
+    StreamArena& operator=(const StreamArena&) = delete;
+
+    StreamArena(StreamArena&& other) noexcept { *this = std::move(other); }
+    StreamArena& operator=(StreamArena&& other) noexcept {
+        if (this != &other) {
+            release();
+            base_ = std::exchange(other.base_, nullptr);
+            capacity_ = std::exchange(other.capacity_, 0);
+            used_ = std::exchange(other.used_, 0);
+            mapped_ = std::exchange(other.mapped_, false);
+            hugePages_ = std::exchange(other.hugePages_, false);
+            numaNode_ = std::exchange(other.numaNode_, -1);
+        }
+        return *this;
+    }
+
+    ~StreamArena() { release(); }
+
+    // Bytes one allocate<T>(count) call consumes, for sizing the arena up front
+    template <typename T>
+    static constexpr size_t bytesFor(size_t count) { return roundUp(count * sizeof(T), kAlignment); }
+
+    // Hand out `count` value-initialized elements; every span starts on a cache-line boundary
+    template <typename T>
+    std::span<T> allocate(size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>, "arena memory is never destroyed per element");
+        size_t bytes = bytesFor<T>(count);
+        if (used_ + bytes > capacity_) throw std::bad_alloc();
+        T* p = reinterpret_cast<T*>(base_ + used_);
+        used_ += bytes;
+        std::uninitialized_value_construct_n(p, count);
+        return {p, count};
+    }
+
+    size_t capacity() const { return capacity_; }
+    size_t used() const { return used_; }
+    bool hugePages() const { return hugePages_; }  // Explicit (MAP_HUGETLB) pages; THP shows up in smaps only
+    int numaNode() const { return numaNode_; }  // -1 unless bound
+    const void* data() const { return base_; }
+
+private:
+    // Preferred-node memory policy for a fresh mapping; false where the kernel has no NUMA support
+    static bool bindToNode(void* p, size_t size, int node) {
+        constexpr int kMaskBits = 8 * sizeof(unsigned long);
+        if (node >= 16 * kMaskBits) return false;
+        unsigned long mask[16] = {};
+        mask[node / kMaskBits] = 1UL << (node % kMaskBits);
+        return syscall(SYS_mbind, p, size, MPOL_PREFERRED, mask, 16 * kMaskBits, 0) == 0;
+    }
+
+    static constexpr size_t roundUp(size_t value, size_t multiple) {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+
+    void release() {
+        if (!base_) return;
+        if (mapped_) munmap(base_, capacity_);
+        else std::free(base_);
+        base_ = nullptr;
+    }
+
+    std::byte* base_ = nullptr;
+    size_t capacity_ = 0;
+    size_t used_ = 0;
+    bool mapped_ = false;
+    bool hugePages_ = false;
+    int numaNode_ = -1;
+};
+
+// FFT plan: radix factorization and twiddle table, built once per chunk size.
+// Plans are read-only during transforms; scratch comes from the caller's arena. The twiddles
+// live in the plan's own arena so they can be placed like the stream buffers that use them.
+struct FftPlan {
+    int n = 0;
+    std::vector<int> factors;     // Radix sequence, product == n
+    StreamArena storage;          // Backs twiddles
+    std::span<Complex> twiddles;  // exp(-2*pi*i*k/n) for k < n
+    int maxFactor = 1;            // Largest radix, sizes the butterfly scratch
+
+    // Scratch elements fft() needs: the out-of-place target plus one butterfly
+    size_t scratchSize() const { return n + maxFactor; }
+
+    // Heap bytes held by the plan, for memory accounting
+    size_t bytes() const { return twiddles.size() * sizeof(Complex) + factors.size() * sizeof(int); }
+};
+
+// `numaNode` >= 0 places the twiddle table on that node; `hugePages` backs it like a huge-page arena
+FftPlan makeFftPlan(int n, int numaNode = -1, bool hugePages = false);
+
+// In-place FFT of data.size() == plan.n points using plan.scratchSize() elements of scratch;
+// performs no heap allocation
+void fft(const FftPlan& plan, std::span<Complex> data, std::span<Complex> scratch);
+
+
+// Quadrature tone-detector bank: an NCO per tone mixes the input to baseband and an order-2 CIC
+// decimator low-passes the product, giving each tone a complex envelope at 1/decimation of the
+// sample rate. Mixing multiplies 16-bit samples by a Q14 sine table; the CIC is adds only, in
+// wrapping 64-bit integrators. Tones sit in groups of kLanes with every per-tone field stored as a
+// kLanes array, so the per-sample loop vectorizes across tones.
+class ToneBank {
+public:
+    static constexpr int kLanes = 8;
+    static constexpr int kOrder = 2;  // CIC integrator/comb pairs
+    static constexpr int kTableBits = 10;
+    static constexpr int kTableSize = 1 << kTableBits;
+    static constexpr int kChunk = 64;  // Samples per oscillator lookup pass
+
+    ToneBank() = default;
+
+    // State for `tonesHz` is carved out of `arena`, which needs bytesFor(tones, maxOutputs) free.
+    // At most `maxOutputs` envelope samples are kept between clear() calls.
+    ToneBank(std::span<const double> tonesHz, int sampleRate, int decimation, int maxOutputs, StreamArena& arena);
+
+    static size_t bytesFor(int tones, int maxOutputs);
+
+    // Mix and filter mono samples; performs no heap allocation
+    void process(std::span<const int16_t> mono);
+
+    // Drop the envelope collected so far; filters and oscillators run on
+    void clear() {
+        outputs_ = 0;
+        framesSinceClear_ = 0;
+    }
+
+    // Zero filters and oscillators too, as for a new stream
+    void reset();
+
+    int tones() const { return tones_; }
+    int decimation() const { return decimation_; }
+    int outputs() const { return outputs_; }  // Envelope samples since clear()
+
+    // Power of tone `t` in envelope sample `k`, relative to a full-scale tone
+    float power(int k, int t) const { return power_[size_t(k) * lanes() + t]; }
+
+    // Frame, counted from clear(), at the centre of envelope sample `k`'s impulse response
+    double outputCentre(int k) const {
+        return firstOutputFrame_ + double(k) * decimation_ - kOrder * (decimation_ - 1) / 2.0;
+    }
+
+private:
+    struct alignas(64) LaneGroup {
+        uint32_t phase[kLanes];
+        uint32_t step[kLanes];
+        uint64_t integI[kOrder][kLanes];
+        uint64_t integQ[kOrder][kLanes];
+        uint64_t combI[kOrder][kLanes];  // Previous input of each comb stage
+        uint64_t combQ[kOrder][kLanes];
+    };
+
+    size_t lanes() const { return groups_.size() * kLanes; }
+    void emit();
+
+    std::span<LaneGroup> groups_;
+    std::span<int16_t> table_;  // sin over one period, plus a quarter period so cos reads it too
+    std::span<float> power_;    // maxOutputs rows of lanes()
+    int tones_ = 0;
+    int decimation_ = 1;
+    int maxOutputs_ = 0;
+    double normalization_ = 0;  // 1 / power of a full-scale tone's envelope
+    int countdown_ = 1;         // Inputs left until the next envelope sample
+    int outputs_ = 0;
+    long framesSinceClear_ = 0;
+    long firstOutputFrame_ = 0;
+};
+
+// Fractional resampler: cubic Lagrange interpolation in Farrow form, one output every step()
+// input samples. The step may change from one output to the next, so a tracking loop can steer it.
+// Outputs lag the input by kLookahead samples; push that many zeros at the end of a stream.
+class FarrowResampler {
+public:
+    static constexpr int kLookahead = 2;
+
+    double step() const { return step_; }
+    void setStep(double step) { step_ = step; }
+
+    // Feed one input sample; calls emit(double) for each output it completes
+    template <typename Emit>
+    void push(double x, Emit&& emit) {
+        x0_ = x1_;
+        x1_ = x2_;
+        x2_ = x3_;
+        x3_ = x;
+        // Polynomial in the position mu between x1 and x2; its coefficients are fixed per input
+        const double c1 = x2_ - x0_ / 3 - x1_ / 2 - x3_ / 6;
+        const double c2 = (x0_ + x2_) / 2 - x1_;
+        const double c3 = (x3_ - x0_) / 6 + (x1_ - x2_) / 2;
+        while (mu_ < 1.0) {
+            emit(((c3 * mu_ + c2) * mu_ + c1) * mu_ + x1_);
+            mu_ += step_;
+        }
+        mu_ -= 1.0;
+    }
+
+private:
+    double x0_ = 0, x1_ = 0, x2_ = 0, x3_ = 0;  // Last four inputs, oldest first
+    double mu_ = 0;
+    double step_ = 1;
+};
+
+// Default tone plan: one (0-tone, 1-tone) pair per bit position, in the order sine_generator sends them
+inline std::vector<std::pair<double, double>> defaultTonePlan() {
+    return {
+        {300, 500},   // Bit 1 (LSB)
+        {700, 900},   // Bit 2
+        {1100, 1300}, // Bit 3
+        {1500, 1700}, // Bit 4
+        {1900, 2100}, // Bit 5
+        {2300, 2500}, // Bit 6
+        {2700, 2900}, // Bit 7
+        {3100, 3300}  // Bit 8 (MSB)
+    };
+}
+
+// How a decoder finds the plan tones in a symbol
+enum class Detector { Fft = FSK_DETECTOR_FFT, ToneBank = FSK_DETECTOR_TONE_BANK, Goertzel = FSK_DETECTOR_GOERTZEL };
+
+// Stream format and tone plan a decoder is built for
+struct DecoderConfig {
+    int sampleRate = 44100;
+    int channels = 1;
+    double symbolRate = 1.0;  // Symbols per second; one symbol is one transform
+    std::vector<std::pair<double, double>> tonePairs = defaultTonePlan();
+    double toleranceHz = 50;
+    double minSymbolFraction = 44000.0 / 44100.0;  // Shorter trailing symbols are dropped
+    bool hugePages = false;
+    int numaNode = -1;  // Place buffers and an owned plan on this node; -1 leaves it to first touch
+    Detector detector = Detector::Fft;
+    bool cfar = false;             // Constant false-alarm rate bit decisions (not for ToneBank)
+    double cfarThresholdDb = 12;   // Tone power over its noise floor needed to count as present
+    bool coarseToFine = false;     // Decide from a short window when it is unambiguous (not with cfar)
+    double coarseConfidenceDb = 20;  // Winning tone over its partner needed, for every bit, to do so
+    bool excision = false;         // Mask persistent off-plan narrowband lines (Detector::Fft, not with cfar)
+    bool clockRecovery = false;    // Track and resample away the recorder's clock offset (Detector::Fft)
+
+    int symbolSamples() const { return std::max(1, static_cast<int>(sampleRate / symbolRate + 0.5)); }
+
+    // Null when usable, otherwise what is wrong
+    const char* validate() const;
+
+    static DecoderConfig fromC(const fsk_config& config);
+};
+
+// Transform bins within toleranceHz of a plan tone, ascending and without duplicates: the bins
+// Detector::Goertzel evaluates. Every tone's nearest bin is included even when the tolerance is
+// narrower than a bin.
+std::vector<int> detectorBins(const DecoderConfig& config);
+
+using FskSymbol = fsk_symbol;
+
+// Streaming decoder: push samples in any block size, get one callback per completed symbol
+class FskDecoder {
+public:
+    using SymbolCallback = std::function<void(const FskSymbol&)>;
+
+    // Bytes held by a decoder, by what they are for
+    struct Footprint {
+        size_t ioBytes = 0;       // Symbol sample buffer
+        size_t spectraBytes = 0;  // Transform input, scratch and peak lists
+        size_t planBytes = 0;     // Twiddles; shared plans count once per decoder here
+    };
+
+    // Throws std::invalid_argument for an invalid config. A shared `plan` must match symbolSamples();
+    // tone-bank decoders have no plan.
+    FskDecoder(DecoderConfig config, SymbolCallback onSymbol, std::shared_ptr<const FftPlan> plan = nullptr);
+
+    FskDecoder(const FskDecoder&) = delete;
+    FskDecoder& operator=(const FskDecoder&) = delete;
+
+    void push(std::span<const double> interleaved);
+    void push(std::span<const float> interleaved);
+    void push(std::span<const int16_t> interleaved);
+
+    // Decode a trailing partial symbol, zero-padded, if it is at least minSymbolFraction long
+    void flush();
+
+    // Drop buffered samples and restart symbol numbering
+    void reset();
+
+    const DecoderConfig& config() const { return config_; }
+    const std::shared_ptr<const FftPlan>& plan() const { return plan_; }  // Null unless Detector::Fft
+    const StreamArena& arena() const { return arena_; }  // Symbol buffer and transform scratch
+    Footprint footprint() const;
+
+    // Spectrum of the most recent symbol, symbolSamples() bins (Detector::Fft only); valid until
+    // the next push
+    std::span<const Complex> spectrum() const { return spectrum_; }
+
+    // The tone bank behind Detector::ToneBank, for its envelopes; valid until the next push
+    const ToneBank& toneBank() const { return toneBank_; }
+
+    // Excision: bins masked in the most recent symbol
+    int excisedBins() const { return excisedBins_; }
+
+    // Clock recovery: the recorder's clock offset as currently estimated, positive when fast
+    double clockOffsetPpm() const { return (clockStep_ - 1) * 1e6; }
+
+    // Coarse-to-fine: frames in the short window, and symbols since reset that it decided alone
+    int coarseFrames() const { return coarseFrames_; }
+    uint64_t coarseSymbols() const { return coarseSymbols_; }
+
+private:
+    static constexpr int kPcmBlock = 1024;  // Tone-bank input is handed over in blocks this long
+    static constexpr int kCfarHistory = 8;  // Symbols the noise floor is tracked over
+    static constexpr int kCfarGuardBins = 3;  // Either side of a tone's peak, left out of its floor
+    static constexpr size_t kCfarMinCells = 8;  // Fewer bins near a tone: estimate from all tones' bins
+    static constexpr double kMinimumPeakDb = -80;  // Relative to full scale; quieter peaks are never tones
+                                                   // where a floor is tracked (CFAR, excision)
+    static constexpr double kCoarsePresenceDb = -60;  // A bit's winning tone must be louder to decide coarsely
+    static constexpr double kExcisionDb = 20;         // Over the median bin, a bin is lit this symbol
+    static constexpr float kExcisionRate = 0.5f;      // Weight of the latest symbol in a bin's lit rate
+    static constexpr float kExcisionPersistence = 0.6f;  // Lit rate at which an off-plan bin is masked
+    static constexpr double kClockLoopGain = 0.25;    // Share of each symbol's rate measurement taken in
+    static constexpr double kMaxClockPpm = 2000;      // Measurements further out are clamped
+
+    template <typename Sample>
+    void pushInterleaved(std::span<const Sample> interleaved, double scale);
+
+    void decodeSymbol(int frames);
+    void detectFft(int frames);
+    void detectGoertzel(int frames);
+    void detectToneBank(int frames);
+    bool decideCoarse(int frames);
+    void matchPeaks(size_t candidates, const double* toneMagnitude, double minMagnitude = 0);
+    void decideCfar(const double* toneMagnitude);
+    double exciseLines(size_t candidates);
+    void trackClock(bool measurable);
+    void acceptSample(double mono) {
+        samples_[filled_++] = mono;
+        if (filled_ == symbolSamples_) decodeSymbol(filled_);
+    }
+    void locateToneBins();
+
+    DecoderConfig config_;
+    SymbolCallback onSymbol_;
+    int symbolSamples_;
+    std::shared_ptr<const FftPlan> plan_;
+    StreamArena arena_;
+    std::span<double> samples_;                    // Mono samples of the symbol being filled
+    std::span<Complex> spectrum_;                  // Transform input/output
+    std::span<Complex> fftScratch_;                // Out-of-place transform target and butterfly
+    std::span<std::pair<double, int>> magnitudes_; // Peak-picking scratch
+    struct GoertzelLanes {
+        double coefficient[4];  // 2 cos(2 pi bin / n); 0 for padding
+        double s1[4];           // Last two recurrence outputs
+        double s2[4];
+    };
+    std::span<int> bins_;                          // detectorBins(), for Goertzel and CFAR
+    std::span<GoertzelLanes> goertzel_;            // Four bins per group, the last padded
+    int toneSlots_[2 * FSK_MAX_BITS] = {};         // Index in bins_ of each plan tone's nearest bin
+    std::pair<int, int> toneWindows_[2 * FSK_MAX_BITS] = {};  // bins_ range within tolerance of each tone
+    std::span<double> cfarHistory_;                // kCfarHistory noise estimates per tone, a ring
+    std::span<double> cfarScratch_;                // Reference cells being ranked
+    int cfarSymbols_ = 0;
+    std::span<float> lineRate_;                    // Excision: per bin, weighted rate of symbols lit
+    std::span<uint8_t> planBin_;                   // Excision: bin is within tolerance of a plan tone
+    std::span<double> excisionScratch_;            // Magnitudes being ranked for the median
+    int excisedBins_ = 0;
+    FarrowResampler resampler_;                    // Clock recovery: input to symbol buffer
+    double clockStep_ = 1;                         // Input samples per nominal sample, as estimated
+    double clockSlip_ = 0;                         // Input samples our symbol boundary trails the true one
+    int clockInputFrames_ = 0;                     // Input frames since the last symbol boundary
+    std::span<GoertzelLanes> coarse_;              // One lane per plan tone, at its exact frequency
+    int coarseFrames_ = 0;
+    uint64_t coarseSymbols_ = 0;
+    ToneBank toneBank_;
+    std::span<int16_t> pcm_;                       // Tone-bank input not yet processed
+    int pcmFilled_ = 0;
+    int filled_ = 0;
+    uint64_t symbolIndex_ = 0;
+    uint64_t framesConsumed_ = 0;
+    FskSymbol symbol_{};
+};
@@ -0,0 +1,232 @@
+/*
+Title: Process Resource Usage Accounting and Reporting
+Name: resource_usage.h
+Author: Ishan Leung
+Language: C++23
+
+Notes:
+Header-only, shared by freq_analyzer.cpp and sine_generator.cpp.
+- Peak RSS, page faults and context switches come from getrusage(); the peak is reset per
+  scope through /proc/self/clear_refs where the kernel allows it.
+- Bytes allocated are tallied by category at the points where each tool sizes its buffers,
+  both process-wide and per thread, so parallel batch jobs can report per file. Peak RSS has no
+  per-thread counterpart, so per-thread reports label it as the process's.
+- Huge-page backing of individual buffers is read back from /proc/self/smaps, since a request
+  for huge pages can quietly end up with 4 KiB ones.
+- Reports print to stderr, as readable text or one JSON object per line.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/resource.h>
+
+// What a block of memory is for
+enum class MemCategory { IoBuffers, Spectra, Plans, Count };
+
+inline const char* memCategoryName(MemCategory category) {
+    switch (category) {
+        case MemCategory::IoBuffers: return "io_buffers";
+        case MemCategory::Spectra: return "spectra";
+        case MemCategory::Plans: return "plans";
+        default: return "other";
+    }
+}
+
+constexpr int kMemCategories = static_cast<int>(MemCategory::Count);
+
+inline std::atomic<uint64_t> g_categoryBytes[kMemCategories];
+inline thread_local uint64_t t_categoryBytes[kMemCategories];
+
+// Record `bytes` allocated for `category`, process-wide and for the calling thread
+inline void accountAllocation(MemCategory category, uint64_t bytes) {
+    int c = static_cast<int>(category);
+    g_categoryBytes[c].fetch_add(bytes, std::memory_order_relaxed);
+    t_categoryBytes[c] += bytes;
+}
+
+// Counters at one point in time; reports are built from the difference of two snapshots
+struct ResourceSnapshot {
+    bool thread = false;
+    double userSeconds = 0;
+    double systemSeconds = 0;
+    long peakRssKb = 0;
+    long minorFaults = 0;
+    long majorFaults = 0;
+    long voluntarySwitches = 0;
+    long involuntarySwitches = 0;
+    uint64_t categoryBytes[kMemCategories] = {};
+
+    // `thread` selects RUSAGE_THREAD and this thread's category tallies instead of the process
+    static ResourceSnapshot take(bool thread = false) {
+        ResourceSnapshot snap;
+        snap.thread = thread;
+        rusage usage{};
+        getrusage(thread ? RUSAGE_THREAD : RUSAGE_SELF, &usage);
+        snap.userSeconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+        snap.systemSeconds = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+        snap.minorFaults = usage.ru_minflt;
+        snap.majorFaults = usage.ru_majflt;
+        snap.voluntarySwitches = usage.ru_nvcsw;
+        snap.involuntarySwitches = usage.ru_nivcsw;
+        snap.peakRssKb = currentPeakRssKb(usage);
+        for (int c = 0; c < kMemCategories; ++c) {
+            snap.categoryBytes[c] = thread ? t_categoryBytes[c] : g_categoryBytes[c].load(std::memory_order_relaxed);
+        }
+        return snap;
+    }
+
+    // VmHWM honours resets through clear_refs; ru_maxrss never goes down
+    static long currentPeakRssKb(const rusage& usage) {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line)) {
+            long kb = 0;
+            if (sscanf(line.c_str(), "VmHWM: %ld kB", &kb) == 1) return kb;
+        }
+        return usage.ru_maxrss;
+    }
+};
+
+// `text` as a quoted JSON string: quotes, backslashes and control characters escaped
+inline std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (char ch : text) {
+        if (ch == '"' || ch == '\\') {
+            out += '\\';
+            out += ch;
+        } else if (static_cast<unsigned char>(ch) < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(ch));
+            out += escaped;
+        } else {
+            out += ch;
+        }
+    }
+    return out + "\"";
+}
+
+// Best-effort reset of the process peak RSS so the next scope reports its own high-water mark
+inline void resetPeakRss() {
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    if (clearRefs) clearRefs << "5";
+}
+
+// Print the usage between two snapshots; `label` names the scope (a file, or "total")
+inline void printResourceReport(const std::string& label, const ResourceSnapshot& begin, const ResourceSnapshot& end,
+                                bool json) {
+    static std::mutex reportMutex;  // Batch workers report concurrently
+    std::lock_guard<std::mutex> lock(reportMutex);
+
+    // Per-thread scopes run alongside each other and never reset the high-water mark, so the peak
+    // they see is the whole process's so far. The report is formatted first and written in one
+    // piece, so nothing else on stderr can land in the middle of it.
+    std::ostringstream out;
+    if (json) {
+        out << "{\"scope\":" << jsonString(label) << (end.thread ? ",\"process_peak_rss_kb\":" : ",\"peak_rss_kb\":")
+            << end.peakRssKb << ",\"alloc_bytes\":{";
+        for (int c = 0; c < kMemCategories; ++c) {
+            out << (c ? "," : "") << '"' << memCategoryName(static_cast<MemCategory>(c))
+                << "\":" << end.categoryBytes[c] - begin.categoryBytes[c];
+        }
+        out << "},\"minor_faults\":" << end.minorFaults - begin.minorFaults
+            << ",\"major_faults\":" << end.majorFaults - begin.majorFaults
+            << ",\"voluntary_ctx_switches\":" << end.voluntarySwitches - begin.voluntarySwitches
+            << ",\"involuntary_ctx_switches\":" << end.involuntarySwitches - begin.involuntarySwitches
+            << ",\"user_s\":" << end.userSeconds - begin.userSeconds
+            << ",\"sys_s\":" << end.systemSeconds - begin.systemSeconds << "}\n";
+    } else {
+
+        out << "\nResource usage (" << label << "):\n";
+        out << (end.thread ? "  Process peak RSS:  " : "  Peak RSS:          ") << end.peakRssKb / 1024.0 << " MiB\n";
+        out << "  Allocated:        ";
+        for (int c = 0; c < kMemCategories; ++c) {
+            out << " " << memCategoryName(static_cast<MemCategory>(c)) << "="
+                << (end.categoryBytes[c] - begin.categoryBytes[c]) / 1024.0 << " KiB";
+        }
+        out << "\n  Page faults:       " << end.minorFaults - begin.minorFaults << " minor, "
+            << end.majorFaults - begin.majorFaults << " major\n";
+        out << "  Context switches:  " << end.voluntarySwitches - begin.voluntarySwitches << " voluntary, "
+            << end.involuntarySwitches - begin.involuntarySwitches << " involuntary\n";
+        out << "  CPU time:          " << end.userSeconds - begin.userSeconds << " s user, "
+            << end.systemSeconds - begin.systemSeconds << " s system\n";
+    }
+    std::string text = out.str();
+    std::cerr.write(text.data(), text.size()).flush();
+}
+
+// How the mapping holding one buffer is backed
+struct HugePageBacking {
+    uint64_t mappedKb = 0;  // Size of the whole mapping
+    uint64_t hugeKb = 0;    // Of which backed by huge pages, explicit or transparent
+    bool hugetlb = false;   // Explicit MAP_HUGETLB mapping
+};
+
+// Look up the mapping containing `addr` in /proc/self/smaps; zeros when it is not found
+inline HugePageBacking hugePageBacking(const void* addr) {
+    HugePageBacking backing;
+    auto target = reinterpret_cast<uintptr_t>(addr);
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    bool inside = false;
+    while (std::getline(smaps, line)) {
+        unsigned long start = 0, end = 0;
+        char dash = 0;
+        if (sscanf(line.c_str(), "%lx%c%lx ", &start, &dash, &end) == 3 && dash == '-') {
+            if (inside) break;  // Past the mapping we wanted
+            inside = target >= start && target < end;
+            continue;
+        }
+        if (!inside) continue;
+        unsigned long kb = 0;
+        if (sscanf(line.c_str(), "Size: %lu kB", &kb) == 1) backing.mappedKb = kb;
+        else if (sscanf(line.c_str(), "AnonHugePages: %lu kB", &kb) == 1) backing.hugeKb += kb;
+        else if (sscanf(line.c_str(), "FilePmdMapped: %lu kB", &kb) == 1) backing.hugeKb += kb;
+        else if (sscanf(line.c_str(), "Private_Hugetlb: %lu kB", &kb) == 1 ||
+                 sscanf(line.c_str(), "Shared_Hugetlb: %lu kB", &kb) == 1) {
+            backing.hugeKb += kb;
+            if (kb) backing.hugetlb = true;
+        } else if (sscanf(line.c_str(), "KernelPageSize: %lu kB", &kb) == 1 && kb >= 2048) {
+            backing.hugetlb = true;
+        }
+    }
+    return backing;
+}
+
+// Print which of the named buffers ended up on huge pages; call once they have been touched
+inline void printHugePageReport(const std::string& label, const std::vector<std::pair<std::string, const void*>>& buffers,
+                                bool json) {
+    static std::mutex reportMutex;
+    std::lock_guard<std::mutex> lock(reportMutex);
+
+    std::ostringstream out;  // Written in one piece, like printResourceReport
+    if (json) out << "{\"scope\":" << jsonString(label) << ",\"huge_pages\":{";
+    else out << "\nHuge pages (" << label << "):\n";
+    bool first = true;
+    for (const auto& [name, addr] : buffers) {
+        if (!addr) continue;
+        HugePageBacking backing = hugePageBacking(addr);
+        const char* kind = backing.hugetlb ? "hugetlb" : backing.hugeKb ? "thp" : "none";
+        if (json) {
+            out << (first ? "" : ",") << jsonString(name) << ":{\"mapped_kb\":" << backing.mappedKb
+                << ",\"huge_kb\":" << backing.hugeKb << ",\"kind\":\"" << kind << "\"}";
+        } else {
+            out << "  " << name << ": " << backing.hugeKb << " of " << backing.mappedKb << " KiB on huge pages ("
+                << kind << ")\n";
+        }
+        first = false;
+    }
+    if (json) out << "}}";
+    out << "\n";
+    std::string text = out.str();
+    std::cerr.write(text.data(), text.size()).flush();
+}
@@ -5,14 +5,38 @@ Author: Ishan Leung
 Language: C++23
 
 Usage:
-g++ -o sine_generator sine_generator.cpp
-./sine_generator -m <binary_message> -s <bits_per_second> <level_dbfs> <sample_rate_khz> -o <output_file_name.wav>
+g++ -std=c++23 -o sine_generator sine_generator.cpp -pthread
+./sine_generator -m <binary_message> -s <bits_per_second> <level_dbfs> <sample_rate_khz> -o <output_file_name.wav> [-c <channels>] [--dither [seed]]
+
+Several sample rates and sample formats from one run (one synthesis pass per rate, files written concurrently):
+./sine_generator -m <binary_message> -s <bits_per_second> <level_dbfs> 44.1 -r 44.1,48,96 -b 16,24,f32 -o <stem.wav>
+
+Corpus builder (seeded, reproducible, generated in parallel, writes <dir>/manifest.tsv):
+./sine_generator --corpus <dir> [-n <file_count>] [--seed <seed>] [--max-len <message_bytes>] [-j <threads>]
+
+Batch mode (one "<binary_message> <bits_per_second> <level_dbfs> <sample_rate_khz> <output.wav>" per
+manifest line, generated in parallel, prints throughput in samples/s):
+./sine_generator --batch <manifest.txt> [-c <channels>] [-j <threads>] [--dither [seed]]
+
+Add --report human|json to print peak RSS, bytes allocated, page faults and context switches to stderr
+at exit (and per file in corpus and batch modes).
 
 Notes:
 - The binary message must be provided as a string of 0s and 1s.
 - `-m` flag is required
 - `-s` flag is optional
 - ``-o` flag is optional
+- `-c` duplicates the signal into that many channels (default 1)
+- `-r` lists sample rates in kHz (overriding the one in `-s`) and `-b` sample formats (16, 24 or
+  f32; default 16). With more than one combination each file is named <stem>_<rate>k_<format>.wav
+- 24-bit, float and more-than-stereo files use a WAVE_FORMAT_EXTENSIBLE header (float adds a fact
+  chunk); 16-bit mono and stereo keep the plain 44-byte header
+- 16- and 24-bit samples are rounded to nearest and clip at full scale (levels above 0 dBFS
+  saturate); --dither adds seeded TPDF dither of +-1 LSB before rounding
+- Samples come from per-rate tables of each byte's tone mix, built on first use and shared by every
+  file at that rate (rates that are not a whole number of Hz fall back to direct synthesis)
+- Corpus files draw sample rate, bits/s, level, channel count and message length from the seed;
+  message length is log-uniform up to --max-len bytes, so large values give multi-GB files
 
 Example Usage:
 g++ -o sine_generator sine_generator.cpp
@@ -26,6 +50,23 @@ g++ -o sine_generator sine_generator.cpp
 #include <string>
 #include <cstdint>
 #include <cstring>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <thread>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "resource_usage.h"
 
 // WAV file header structure
 struct WavHeader {
@@ -44,6 +85,39 @@ struct WavHeader {
     uint32_t data_bytes;
 };
 
+// Header for WAVE_FORMAT_EXTENSIBLE, which the format requires for more than two channels or
+// more than 16 bits; the actual encoding moves into the sub-format GUID
+struct WavExtensibleHeader {
+    char riff_header[4] = {'R', 'I', 'F', 'F'};
+    uint32_t wav_size;
+    char wave_header[4] = {'W', 'A', 'V', 'E'};
+    char fmt_header[4] = {'f', 'm', 't', ' '};
+    uint32_t fmt_chunk_size = 40;
+    uint16_t audio_format = 0xFFFE;
+    uint16_t num_channels;
+    uint32_t sample_rate;
+    uint32_t byte_rate;
+    uint16_t sample_alignment;
+    uint16_t bit_depth;
+    uint16_t extension_size = 22;
+    uint16_t valid_bits;
+    uint32_t channel_mask;
+    uint8_t sub_format[16] = {0, 0, 0, 0, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+};
+static_assert(sizeof(WavExtensibleHeader) == 60, "WAV header must not be padded");
+
+// Frame count that non-PCM (float) files carry ahead of the data
+struct WavFactChunk {
+    char fact_header[4] = {'f', 'a', 'c', 't'};
+    uint32_t chunk_size = 4;
+    uint32_t sample_length;
+};
+
+struct WavDataChunk {
+    char data_header[4] = {'d', 'a', 't', 'a'};
+    uint32_t data_bytes;
+};
+
 // Function to convert binary string to vector of 8-bit values
 std::vector<uint8_t> binary_to_bytes(const std::string& binary) {
     std::vector<uint8_t> bytes;
@@ -55,65 +129,611 @@ std::vector<uint8_t> binary_to_bytes(const std::string& binary) {
     return bytes;
 }
 
-// Function to generate a sine .WAV file from a binary message
-void sine_gen(const std::string& msg, double bps, double level_dbfs, double sample_rate_khz, const std::string& output_file) {
-    double sample_rate = sample_rate_khz * 1000.0;
-    double amplitude = pow(10, level_dbfs / 20.0);
+// Sample encodings an output file can use
+enum class SampleFormat { Pcm16, Pcm24, Float32 };
+
+const char* sample_format_name(SampleFormat format) {
+    switch (format) {
+        case SampleFormat::Pcm24: return "24";
+        case SampleFormat::Float32: return "f32";
+        default: return "16";
+    }
+}
+
+bool parse_sample_format(const std::string& name, SampleFormat& format) {
+    if (name == "16") format = SampleFormat::Pcm16;
+    else if (name == "24") format = SampleFormat::Pcm24;
+    else if (name == "f32" || name == "float") format = SampleFormat::Float32;
+    else return false;
+    return true;
+}
+
+int bytes_per_sample(SampleFormat format) {
+    return format == SampleFormat::Pcm16 ? 2 : format == SampleFormat::Pcm24 ? 3 : 4;
+}
+
+// One file to render: where, at what rate and in which encoding
+struct OutputSpec {
+    std::string path;
+    double sample_rate_khz;
+    SampleFormat format;
+};
+
+// What to play when, worked out once per message and shared by every output rendered from it
+struct ToneSchedule {
+    std::vector<uint8_t> bytes;
+    std::vector<std::array<double, 8>> omegas;  // Per byte: 2*pi*f of each bit's tone, MSB first
+    double bit_duration;
+};
+
+// Frequencies for each bit position (0 or 1)
+const int freq_table[8][2] = {
+    {300, 500},   // Bit 1 (LSB)
+    {700, 900},   // Bit 2
+    {1100, 1300}, // Bit 3
+    {1500, 1700}, // Bit 4
+    {1900, 2100}, // Bit 5
+    {2300, 2500}, // Bit 6
+    {2700, 2900}, // Bit 7
+    {3100, 3300}  // Bit 8 (MSB)
+};
+
+// Every tone is a multiple of this, so all of them repeat together after a whole number of samples
+const int tone_step_hz = 100;
 
-    // Frequencies for each bit position (0 or 1)
-    const double freq_table[8][2] = {
-        {300, 500},   // Bit 1 (LSB)
-        {700, 900},   // Bit 2
-        {1100, 1300}, // Bit 3
-        {1500, 1700}, // Bit 4
-        {1900, 2100}, // Bit 5
-        {2300, 2500}, // Bit 6
-        {2700, 2900}, // Bit 7
-        {3100, 3300}  // Bit 8 (MSB)
+ToneSchedule make_schedule(const std::string& msg, double bps) {
+    ToneSchedule schedule;
+    schedule.bytes = binary_to_bytes(msg);
+    schedule.bit_duration = 1.0 / bps;
+    for (uint8_t byte_value : schedule.bytes) {
+        std::array<double, 8> omegas;
+        for (int bit = 0; bit < 8; ++bit) {
+            bool bit_value = (byte_value >> (7 - bit)) & 1;
+            omegas[bit] = 2.0 * M_PI * freq_table[bit][bit_value];
+        }
+        schedule.omegas.push_back(omegas);
+    }
+    accountAllocation(MemCategory::IoBuffers, schedule.bytes.size() * (1 + sizeof(std::array<double, 8>)));
+    return schedule;
+}
+
+// Frames in the rendering of `schedule` at `sample_rate`
+uint64_t frame_count(const ToneSchedule& schedule, double sample_rate) {
+    return static_cast<uint64_t>(schedule.bit_duration * schedule.bytes.size() * sample_rate);
+}
+
+// Precomputed waveforms for one sample rate: a period of each plan tone (the oscillator tables)
+// and, mixed from them on first use, the eight-tone sum of each byte value over the period all
+// tones share. Sample i of a byte is then entry i mod period() instead of eight sin() calls.
+class SymbolCache {
+public:
+    explicit SymbolCache(uint32_t sample_rate) : period_(sample_rate / std::gcd(sample_rate, uint32_t(tone_step_hz))) {
+        oscillators_.resize(16 * period_);
+        for (int tone = 0; tone < 16; ++tone) {
+            uint64_t freq = freq_table[tone / 2][tone % 2];
+            for (size_t j = 0; j < period_; ++j) {
+                // Reduce the phase in integers so the table is exact however long the file
+                double cycles = static_cast<double>(freq * j % sample_rate) / sample_rate;
+                oscillators_[tone * period_ + j] = sin(2.0 * M_PI * cycles);
+            }
+        }
+        accountAllocation(MemCategory::Plans, oscillators_.size() * sizeof(double));
+    }
+
+    size_t period() const { return period_; }
+
+    // Sum of the eight tones sending `byte_value`; safe to call from several threads
+    const double* waveform(uint8_t byte_value) {
+        std::call_once(built_[byte_value], [&] {
+            std::vector<double>& wave = symbols_[byte_value];
+            wave.assign(period_, 0.0);
+            for (int bit = 0; bit < 8; ++bit) {
+                int bit_value = (byte_value >> (7 - bit)) & 1;
+                const double* osc = &oscillators_[(bit * 2 + bit_value) * period_];
+                for (size_t j = 0; j < period_; ++j) wave[j] += osc[j];
+            }
+            accountAllocation(MemCategory::Plans, period_ * sizeof(double));
+        });
+        return symbols_[byte_value].data();
+    }
+
+private:
+    size_t period_;
+    std::vector<double> oscillators_;  // 16 tables of period_ entries, tone 2 * bit + bit_value
+    std::array<std::once_flag, 256> built_;
+    std::array<std::vector<double>, 256> symbols_;
+};
+
+// The process-wide cache for `sample_rate`, shared by every file rendered at it; nullptr when the
+// rate is not a whole number of Hz or the shared period is too long to be worth tabulating
+SymbolCache* symbol_cache(double sample_rate) {
+    const uint32_t max_period = 1 << 16;
+    static std::mutex mutex;
+    static std::map<uint32_t, std::unique_ptr<SymbolCache>> caches;
+
+    double rounded = std::round(sample_rate);
+    if (rounded < 1 || rounded > UINT32_MAX || std::fabs(sample_rate - rounded) > 1e-6) return nullptr;
+    uint32_t rate = static_cast<uint32_t>(rounded);
+    if (rate / std::gcd(rate, uint32_t(tone_step_hz)) > max_period) return nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_ptr<SymbolCache>& cache = caches[rate];
+    if (!cache) cache = std::make_unique<SymbolCache>(rate);
+    return cache.get();
+}
+
+// Header bytes for `num_samples` frames of `format`; false if they do not fit in a WAV file.
+// Plain 16-bit mono and stereo keep the classic 44-byte header; everything else is written as
+// WAVE_FORMAT_EXTENSIBLE, with a fact chunk for float.
+bool make_header(std::vector<char>& bytes, double sample_rate, int num_channels, SampleFormat format, uint64_t num_samples) {
+    const uint16_t bit_depth = static_cast<uint16_t>(8 * bytes_per_sample(format));
+    const uint16_t alignment = static_cast<uint16_t>(num_channels * (bit_depth / 8));
+    const uint64_t data_bytes = num_samples * alignment;
+    auto append = [&](const auto& chunk) {
+        const char* raw = reinterpret_cast<const char*>(&chunk);
+        bytes.insert(bytes.end(), raw, raw + sizeof(chunk));
     };
+    bytes.clear();
 
-    std::vector<uint8_t> bytes = binary_to_bytes(msg);
-    int num_bytes = bytes.size();
-    double bit_duration = 1.0 / bps;
-    double total_duration = bit_duration * num_bytes;
-    uint32_t num_samples = static_cast<uint32_t>(total_duration * sample_rate);
+    if (format == SampleFormat::Pcm16 && num_channels <= 2) {
+        WavHeader header;
+        header.num_channels = static_cast<uint16_t>(num_channels);
+        header.sample_rate = static_cast<uint32_t>(sample_rate);
+        header.sample_alignment = alignment;
+        header.bit_depth = bit_depth;
+        header.byte_rate = header.sample_rate * alignment;
+        if (data_bytes > UINT32_MAX - (sizeof(header) - 8)) return false;
+        header.data_bytes = static_cast<uint32_t>(data_bytes);
+        header.wav_size = static_cast<uint32_t>(sizeof(header) - 8 + data_bytes);
+        append(header);
+        return true;
+    }
 
-    WavHeader header;
+    // Speaker positions for the usual layouts (mono centre, stereo, 3.0, quad, 5.0, 5.1, 6.1, 7.1)
+    const uint32_t channel_masks[] = {0x4, 0x3, 0x7, 0x33, 0x37, 0x3F, 0x13F, 0x63F};
+    const bool is_float = format == SampleFormat::Float32;
+    WavExtensibleHeader header;
+    header.num_channels = static_cast<uint16_t>(num_channels);
     header.sample_rate = static_cast<uint32_t>(sample_rate);
-    header.byte_rate = header.sample_rate * header.num_channels * (header.bit_depth / 8);
-    header.data_bytes = num_samples * (header.bit_depth / 8);
-    header.wav_size = 36 + header.data_bytes;
+    header.sample_alignment = alignment;
+    header.bit_depth = bit_depth;
+    header.valid_bits = bit_depth;
+    header.byte_rate = header.sample_rate * alignment;
+    header.channel_mask = num_channels <= 8 ? channel_masks[num_channels - 1] : 0;  // 0: no positions assigned
+    header.sub_format[0] = is_float ? 3 : 1;  // KSDATAFORMAT_SUBTYPE_IEEE_FLOAT or _PCM
+    const uint64_t overhead = sizeof(header) - 8 + (is_float ? sizeof(WavFactChunk) : 0) + sizeof(WavDataChunk);
+    if (data_bytes > UINT32_MAX - overhead) return false;
+    header.wav_size = static_cast<uint32_t>(overhead + data_bytes);
+    append(header);
+    if (is_float) {
+        WavFactChunk fact;
+        fact.sample_length = static_cast<uint32_t>(num_samples);
+        append(fact);
+    }
+    WavDataChunk data;
+    data.data_bytes = static_cast<uint32_t>(data_bytes);
+    append(data);
+    return true;
+}
 
-    std::vector<int16_t> samples(num_samples);
+// TPDF dither for the integer formats: two uniform variates of +-1/2 LSB summed per sample. The
+// noise is a hash of (seed, frame index) rather than a sequential generator, so it vectorizes and
+// comes out the same however the stream is split into blocks.
+struct Dither {
+    bool enabled = false;
+    uint32_t seed = 0;
+};
 
-    for (uint32_t i = 0; i < num_samples; i++) {
-        double t = static_cast<double>(i) / sample_rate;
-        int byte_index = static_cast<int>(t / bit_duration);
+// Counter-based generator: a strong 32-bit integer mix of the frame index
+inline uint32_t dither_hash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
 
-        if (byte_index >= num_bytes) byte_index = num_bytes - 1;
-        uint8_t current_byte = bytes[byte_index];
+// Dither in LSBs for `frame`: the difference of the hash's two 16-bit halves, triangular on (-1, 1)
+inline float dither_lsb(const Dither& dither, uint32_t frame) {
+    uint32_t h = dither_hash(frame + dither.seed * 0x9e3779b9u);
+    return static_cast<float>(static_cast<int32_t>(h >> 16) - static_cast<int32_t>(h & 0xffff)) * (1.0f / 65536.0f);
+}
 
-        double sample = 0.0;
-        for (int bit = 0; bit < 8; ++bit) {
-            bool bit_value = (current_byte >> (7 - bit)) & 1;
-            double freq = freq_table[bit][bit_value];
-            sample += sin(2.0 * M_PI * freq * t);
+#if defined(__SSE2__)
+// 32-bit lane multiply; SSE2 only multiplies the even lanes, so do the odd ones separately
+inline __m128i mullo_epi32(__m128i a, __m128i b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// dither_lsb() for frames frame .. frame + 3
+inline __m128 dither_lsb4(const Dither& dither, uint32_t frame) {
+    __m128i x = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(frame + dither.seed * 0x9e3779b9u)), _mm_setr_epi32(0, 1, 2, 3));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+    x = mullo_epi32(x, _mm_set1_epi32(0x7feb352d));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 15));
+    x = mullo_epi32(x, _mm_set1_epi32(static_cast<int>(0x846ca68bu)));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+    __m128i diff = _mm_sub_epi32(_mm_srli_epi32(x, 16), _mm_and_si128(x, _mm_set1_epi32(0xffff)));
+    return _mm_mul_ps(_mm_cvtepi32_ps(diff), _mm_set1_ps(1.0f / 65536.0f));
+}
+#endif
+
+// Quantizers for `count` samples (full scale = 1) starting at stream frame `first_frame`: scaled,
+// optionally dithered, rounded to nearest and saturated, so levels above 0 dBFS clip instead of
+// wrapping. 16 bits work in float, which resolves them with room to spare; 24 bits need double,
+// since a float's step at 2^22 and above is already half an LSB.
+void quantize_s16(const double* in, size_t count, uint64_t first_frame, const Dither& dither, int16_t* out) {
+    const float scale = 32767.0f;
+    const uint32_t frame = static_cast<uint32_t>(first_frame);  // WAV data never reaches 2^32 frames
+    size_t k = 0;
+#if defined(__SSE2__)
+    const __m128 vscale = _mm_set1_ps(scale), vlo = _mm_set1_ps(-32768.0f), vhi = _mm_set1_ps(scale);
+    auto convert4 = [&](size_t at) {
+        __m128 x = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(in + at)), _mm_cvtpd_ps(_mm_loadu_pd(in + at + 2)));
+        x = _mm_mul_ps(x, vscale);
+        if (dither.enabled) x = _mm_add_ps(x, dither_lsb4(dither, frame + static_cast<uint32_t>(at)));
+        return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(x, vlo), vhi));  // Rounds to nearest even
+    };
+    for (; k + 8 <= count; k += 8) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + k), _mm_packs_epi32(convert4(k), convert4(k + 4)));
+    }
+#endif
+    for (; k < count; ++k) {
+        float x = static_cast<float>(in[k]) * scale;
+        if (dither.enabled) x += dither_lsb(dither, frame + static_cast<uint32_t>(k));
+        out[k] = static_cast<int16_t>(std::lrint(std::clamp(x, -32768.0f, scale)));
+    }
+}
+
+// 24-bit values in the low bits of each int32_t
+void quantize_s24(const double* in, size_t count, uint64_t first_frame, const Dither& dither, int32_t* out) {
+    const double scale = 8388607.0;
+    const uint32_t frame = static_cast<uint32_t>(first_frame);
+    size_t k = 0;
+#if defined(__SSE2__)
+    const __m128d vscale = _mm_set1_pd(scale), vlo = _mm_set1_pd(-8388608.0), vhi = _mm_set1_pd(scale);
+    for (; k + 4 <= count; k += 4) {
+        __m128d a = _mm_mul_pd(_mm_loadu_pd(in + k), vscale);
+        __m128d b = _mm_mul_pd(_mm_loadu_pd(in + k + 2), vscale);
+        if (dither.enabled) {
+            __m128 d = dither_lsb4(dither, frame + static_cast<uint32_t>(k));  // Multiples of 2^-16: exact in double
+            a = _mm_add_pd(a, _mm_cvtps_pd(d));
+            b = _mm_add_pd(b, _mm_cvtps_pd(_mm_movehl_ps(d, d)));
         }
+        __m128i lo = _mm_cvtpd_epi32(_mm_min_pd(_mm_max_pd(a, vlo), vhi));  // Two results in the low lanes
+        __m128i hi = _mm_cvtpd_epi32(_mm_min_pd(_mm_max_pd(b, vlo), vhi));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + k), _mm_unpacklo_epi64(lo, hi));
+    }
+#endif
+    for (; k < count; ++k) {
+        double x = in[k] * scale;
+        if (dither.enabled) x += dither_lsb(dither, frame + static_cast<uint32_t>(k));
+        out[k] = static_cast<int32_t>(std::lrint(std::clamp(x, -8388608.0, scale)));
+    }
+}
+
+// Encode `frames` mono samples (full scale = 1) from stream frame `first_frame` into `out`, each
+// repeated over `num_channels`
+void encode_block(const double* mono, uint64_t first_frame, uint64_t frames, int num_channels, SampleFormat format,
+                  const Dither& dither, std::vector<char>& out) {
+    const int width = bytes_per_sample(format);
+    out.resize(frames * num_channels * width);
+    char* dst = out.data();
+    if (format == SampleFormat::Pcm16) {
+        thread_local std::vector<int16_t> pcm;
+        pcm.resize(frames);
+        quantize_s16(mono, frames, first_frame, dither, pcm.data());
+        if (num_channels == 1) {
+            std::memcpy(dst, pcm.data(), frames * 2);
+            return;
+        }
+        for (uint64_t j = 0; j < frames; ++j) {
+            for (int ch = 0; ch < num_channels; ++ch, dst += 2) std::memcpy(dst, &pcm[j], 2);
+        }
+    } else if (format == SampleFormat::Pcm24) {
+        thread_local std::vector<int32_t> pcm;
+        pcm.resize(frames);
+        quantize_s24(mono, frames, first_frame, dither, pcm.data());
+        for (uint64_t j = 0; j < frames; ++j) {
+            for (int ch = 0; ch < num_channels; ++ch, dst += 3) std::memcpy(dst, &pcm[j], 3);  // Little-endian: the low three bytes
+        }
+    } else {
+        for (uint64_t j = 0; j < frames; ++j) {
+            float value = static_cast<float>(mono[j]);
+            for (int ch = 0; ch < num_channels; ++ch, dst += 4) std::memcpy(dst, &value, 4);
+        }
+    }
+}
+
+// Render every output of one sample rate: each block of the signal is synthesized once and encoded
+// into each of the requested sample formats. Runs beside other rates, so errors go out one whole
+// line at a time and success is left to the caller to report.
+bool render_rate(const ToneSchedule& schedule, double amplitude, double sample_rate, int num_channels,
+                 const std::vector<const OutputSpec*>& outputs, const Dither& dither) {
+    const int num_bytes = static_cast<int>(schedule.bytes.size());
+    uint64_t num_samples = frame_count(schedule, sample_rate);
+    SymbolCache* cache = symbol_cache(sample_rate);
+
+    std::vector<std::ofstream> files;
+    for (const OutputSpec* output : outputs) {
+        std::vector<char> header;
+        if (!make_header(header, sample_rate, num_channels, output->format, num_samples)) {
+            std::cerr << "Message too long for a WAV file: " + output->path + "\n";
+            return false;
+        }
+        files.emplace_back(output->path, std::ios::binary);
+        if (!files.back()) {
+            std::cerr << "Failed to open file: " + output->path + "\n";
+            return false;
+        }
+        files.back().write(header.data(), header.size());
+    }
+
+    const uint64_t block_frames = 65536;
+    std::vector<double> mono(block_frames);
+    std::vector<char> encoded;
+    encoded.reserve(block_frames * num_channels * 4);
+    // The quantizer's scratch holds up to an int32_t per frame
+    accountAllocation(MemCategory::IoBuffers, mono.size() * (sizeof(double) + sizeof(int32_t)) + encoded.capacity());
+
+    size_t phase = 0;  // i mod cache->period()
+    int wave_byte = -1;
+    const double* wave = nullptr;
+    for (uint64_t start = 0; start < num_samples; start += block_frames) {
+        uint64_t frames = std::min(block_frames, num_samples - start);
+        for (uint64_t j = 0; j < frames; j++) {
+            uint64_t i = start + j;
+            double t = static_cast<double>(i) / sample_rate;
+            int byte_index = static_cast<int>(t / schedule.bit_duration);
+            if (byte_index >= num_bytes) byte_index = num_bytes - 1;
+
+            double sample = 0.0;
+            if (cache) {
+                if (byte_index != wave_byte) {
+                    wave_byte = byte_index;
+                    wave = cache->waveform(schedule.bytes[byte_index]);
+                }
+                sample = wave[phase];
+                if (++phase == cache->period()) phase = 0;
+            } else {
+                const std::array<double, 8>& omegas = schedule.omegas[byte_index];
+                for (int bit = 0; bit < 8; ++bit) sample += sin(omegas[bit] * t);
+            }
+            mono[j] = (sample / 8.0) * amplitude;
+        }
+        for (size_t k = 0; k < outputs.size(); ++k) {
+            encode_block(mono.data(), start, frames, num_channels, outputs[k]->format, dither, encoded);
+            files[k].write(encoded.data(), encoded.size());
+        }
+    }
+
+    for (size_t k = 0; k < outputs.size(); ++k) {
+        if (!files[k]) {
+            std::cerr << "Failed to write file: " + outputs[k]->path + "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Render a message into several files at once: the schedule is shared, each sample rate is
+// synthesized once for all of its sample formats, and the rates render and write concurrently
+bool render_outputs(const ToneSchedule& schedule, double level_dbfs, int num_channels,
+                    const std::vector<OutputSpec>& outputs, bool quiet = false, const Dither& dither = {}) {
+    double amplitude = pow(10, level_dbfs / 20.0);
+    std::vector<double> rates;
+    for (const OutputSpec& output : outputs) {
+        if (std::find(rates.begin(), rates.end(), output.sample_rate_khz) == rates.end()) rates.push_back(output.sample_rate_khz);
+    }
+
+    std::vector<char> rendered(rates.size());  // Per rate; written by that rate's thread only
+    auto render = [&](size_t r) {
+        std::vector<const OutputSpec*> group;
+        for (const OutputSpec& output : outputs) {
+            if (output.sample_rate_khz == rates[r]) group.push_back(&output);
+        }
+        rendered[r] = render_rate(schedule, amplitude, rates[r] * 1000.0, num_channels, group, dither);
+    };
+    std::vector<std::thread> writers;
+    for (size_t r = 1; r < rates.size(); ++r) writers.emplace_back(render, r);
+    if (!rates.empty()) render(0);
+    for (std::thread& writer : writers) writer.join();
+
+    // Report from this thread, in the order the outputs were asked for
+    bool ok = true;
+    for (const OutputSpec& output : outputs) {
+        size_t r = std::find(rates.begin(), rates.end(), output.sample_rate_khz) - rates.begin();
+        if (!rendered[r]) ok = false;
+        else if (!quiet) std::cout << "Generated WAV file: " << output.path << std::endl;
+    }
+    return ok;
+}
+
+// Function to generate a sine .WAV file from a binary message
+// Samples are rendered and written in blocks, so file size is bounded only by the WAV format
+bool sine_gen(const std::string& msg, double bps, double level_dbfs, double sample_rate_khz, const std::string& output_file,
+              int num_channels = 1, bool quiet = false) {
+    return render_outputs(make_schedule(msg, bps), level_dbfs, num_channels,
+                          {{output_file, sample_rate_khz, SampleFormat::Pcm16}}, quiet);
+}
+
+// One corpus entry; every field is derived from (seed, index) alone
+struct CorpusEntry {
+    std::string file_name;
+    std::string msg;
+    double bps;
+    double level_dbfs;
+    double sample_rate_khz;
+    int num_channels;
+};
+
+CorpusEntry make_corpus_entry(uint64_t seed, int index, int max_len) {
+    const double sample_rates_khz[] = {8, 16, 22.05, 44.1, 48, 96};
+    const double bps_choices[] = {0.5, 1, 2, 4, 8};
+    const int channel_choices[] = {1, 1, 1, 2, 2, 4, 6, 8};
+
+    // Seed each entry independently so the corpus is identical for any thread count
+    std::seed_seq seq{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32), static_cast<uint32_t>(index)};
+    std::mt19937_64 rng(seq);
+
+    CorpusEntry entry;
+    entry.sample_rate_khz = sample_rates_khz[rng() % std::size(sample_rates_khz)];
+    entry.bps = bps_choices[rng() % std::size(bps_choices)];
+    entry.level_dbfs = -std::uniform_real_distribution<double>(0.0, 30.0)(rng);
+    entry.num_channels = channel_choices[rng() % std::size(channel_choices)];
+
+    // Log-uniform message length: mostly short clips with a long tail up to max_len bytes
+    double log_len = std::uniform_real_distribution<double>(0.0, std::log(static_cast<double>(max_len)))(rng);
+    int num_bytes = std::clamp(static_cast<int>(std::exp(log_len)), 1, max_len);
+    for (int b = 0; b < num_bytes; ++b) {
+        uint8_t byte_value = static_cast<uint8_t>(rng());
+        for (int bit = 7; bit >= 0; --bit) entry.msg += ((byte_value >> bit) & 1) ? '1' : '0';
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "corpus_%06d.wav", index);
+    entry.file_name = name;
+    return entry;
+}
+
+// Build a seeded corpus in parallel and write manifest.tsv with the expected payload of every file
+int build_corpus(const std::string& dir, int count, uint64_t seed, int max_len, int threads,
+                 const std::string& report_format = "") {
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        std::cerr << "Failed to create directory: " << dir << std::endl;
+        return 1;
+    }
+
+    std::vector<CorpusEntry> entries;
+    for (int i = 0; i < count; ++i) entries.push_back(make_corpus_entry(seed, i, max_len));
+
+    std::atomic<int> next{0};
+    std::atomic<int> failures{0};
+    std::atomic<uint64_t> total_bytes{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            for (int i; (i = next.fetch_add(1)) < count;) {
+                const CorpusEntry& e = entries[i];
+                std::string path = (std::filesystem::path(dir) / e.file_name).string();
+                ResourceSnapshot file_start = ResourceSnapshot::take(true);
+                if (!sine_gen(e.msg, e.bps, e.level_dbfs, e.sample_rate_khz, path, e.num_channels, true)) {
+                    ++failures;
+                    continue;
+                }
+                if (!report_format.empty()) {
+                    printResourceReport(path, file_start, ResourceSnapshot::take(true), report_format == "json");
+                }
+                total_bytes += std::filesystem::file_size(path, ec);
+            }
+        });
+    }
+    for (std::thread& worker : workers) worker.join();
+
+    std::ofstream manifest(std::filesystem::path(dir) / "manifest.tsv");
+    manifest << "file\tbits_per_second\tlevel_dbfs\tsample_rate_khz\tchannels\tbytes\tmessage_hex\tmessage_binary\n";
+    for (const CorpusEntry& e : entries) {
+        std::ostringstream hex;
+        for (uint8_t b : binary_to_bytes(e.msg)) {
+            const char digits[] = "0123456789abcdef";
+            hex << digits[b >> 4] << digits[b & 15];
+        }
+        manifest << e.file_name << '\t' << e.bps << '\t' << e.level_dbfs << '\t' << e.sample_rate_khz << '\t'
+                 << e.num_channels << '\t' << e.msg.size() / 8 << '\t' << hex.str() << '\t' << e.msg << '\n';
+    }
+
+    std::cout << "Generated corpus: " << count - failures << " files, " << total_bytes / (1024.0 * 1024.0)
+              << " MiB in " << dir << " (seed " << seed << ")" << std::endl;
+    return failures ? 1 : 0;
+}
+
+// One line of a batch manifest
+struct BatchJob {
+    std::string msg;
+    double bps;
+    double level_dbfs;
+    double sample_rate_khz;
+    std::string path;
+};
 
-        sample = (sample / 8.0) * amplitude * 32767.0;
-        samples[i] = static_cast<int16_t>(sample);
+// Read a manifest of whitespace-separated "message bps level_dbfs sample_rate_khz output.wav" lines;
+// blank lines, # comments and a leading "message ..." header are skipped
+bool read_batch_manifest(const std::string& manifest_path, std::vector<BatchJob>& jobs) {
+    std::ifstream manifest(manifest_path);
+    if (!manifest) {
+        std::cerr << "Failed to open manifest: " << manifest_path << std::endl;
+        return false;
     }
+    int line_number = 0;
+    for (std::string line; std::getline(manifest, line);) {
+        ++line_number;
+        std::istringstream fields(line);
+        BatchJob job;
+        if (!(fields >> job.msg) || job.msg[0] == '#') continue;
+        if (line_number == 1 && job.msg == "message") continue;
+        fields >> job.bps >> job.level_dbfs >> job.sample_rate_khz >> job.path;
+        if (!fields || job.msg.find_first_not_of("01") != std::string::npos || job.msg.size() < 8 || job.bps <= 0 ||
+            job.sample_rate_khz <= 0) {
+            std::cerr << "Error: " << manifest_path << ':' << line_number
+                      << ": expected <binary_message> <bits_per_second> <level_dbfs> <sample_rate_khz> <output.wav>"
+                      << std::endl;
+            return false;
+        }
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+// Generate every file of a manifest on `threads` workers. Jobs with the same message and bit rate
+// share one schedule, and all jobs at a sample rate share its symbol cache, so the sin() work is
+// paid once per rate rather than per sample.
+int run_batch(const std::string& manifest_path, int num_channels, int threads, const Dither& dither,
+              const std::string& report_format = "") {
+    std::vector<BatchJob> jobs;
+    if (!read_batch_manifest(manifest_path, jobs)) return 1;
 
-    std::ofstream file(output_file, std::ios::binary);
-    if (!file) {
-        std::cerr << "Failed to open file: " << output_file << std::endl;
-        return;
+    std::map<std::pair<std::string, double>, ToneSchedule> schedules;
+    for (const BatchJob& job : jobs) {
+        auto key = std::make_pair(job.msg, job.bps);
+        if (!schedules.count(key)) schedules.emplace(key, make_schedule(job.msg, job.bps));
     }
 
-    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
-    file.write(reinterpret_cast<const char*>(samples.data()), samples.size() * sizeof(int16_t));
+    auto begin = std::chrono::steady_clock::now();
+    const int count = static_cast<int>(jobs.size());
+    std::atomic<int> next{0};
+    std::atomic<int> failures{0};
+    std::atomic<uint64_t> total_samples{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < std::min(threads, count); ++t) {
+        workers.emplace_back([&] {
+            for (int i; (i = next.fetch_add(1)) < count;) {
+                const BatchJob& job = jobs[i];
+                const ToneSchedule& schedule = schedules.at({job.msg, job.bps});
+                ResourceSnapshot file_start = ResourceSnapshot::take(true);
+                if (!render_outputs(schedule, job.level_dbfs, num_channels,
+                                    {{job.path, job.sample_rate_khz, SampleFormat::Pcm16}}, true, dither)) {
+                    ++failures;
+                    continue;
+                }
+                if (!report_format.empty()) {
+                    printResourceReport(job.path, file_start, ResourceSnapshot::take(true), report_format == "json");
+                }
+                total_samples += frame_count(schedule, job.sample_rate_khz * 1000.0) * num_channels;
+            }
+        });
+    }
+    for (std::thread& worker : workers) worker.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
 
-    std::cout << "Generated WAV file: " << output_file << std::endl;
+    std::cout << "Generated batch: " << count - failures << " of " << count << " files, " << total_samples
+              << " samples in " << seconds << " s (" << total_samples / std::max(seconds, 1e-9) << " samples/s, "
+              << std::min(threads, count) << " threads)" << std::endl;
+    return failures ? 1 : 0;
 }
 
 int main(int argc, char* argv[]) {
@@ -122,6 +742,17 @@ int main(int argc, char* argv[]) {
     double level_dbfs = -3;
     double sample_rate_khz = 44.1;
     std::string output_file;
+    int num_channels = 1;
+    std::vector<double> rates_khz;
+    std::vector<SampleFormat> formats;
+    std::string corpus_dir;
+    std::string batch_manifest;
+    int corpus_count = 1000;
+    uint64_t corpus_seed = 1;
+    int corpus_max_len = 64;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string report_format;
+    Dither dither;
 
     // Parsing command-line arguments
     for (int i = 1; i < argc; ++i) {
@@ -131,9 +762,65 @@ int main(int argc, char* argv[]) {
             sscanf(argv[++i], "%lf %lf %lf", &bps, &level_dbfs, &sample_rate_khz);
         } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
             output_file = argv[++i];
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            num_channels = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            std::stringstream list(argv[++i]);
+            for (std::string item; std::getline(list, item, ',');) {
+                double rate = atof(item.c_str());
+                if (rate <= 0) {
+                    std::cerr << "Error: Bad sample rate: " << item << std::endl;
+                    return 1;
+                }
+                rates_khz.push_back(rate);
+            }
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            std::stringstream list(argv[++i]);
+            for (std::string item; std::getline(list, item, ',');) {
+                SampleFormat format;
+                if (!parse_sample_format(item, format)) {
+                    std::cerr << "Error: Unknown sample format: " << item << " (16, 24 or f32)" << std::endl;
+                    return 1;
+                }
+                formats.push_back(format);
+            }
+        } else if (strcmp(argv[i], "--dither") == 0) {
+            dither.enabled = true;
+            if (i + 1 < argc && isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+                dither.seed = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+            }
+        } else if (strcmp(argv[i], "--corpus") == 0 && i + 1 < argc) {
+            corpus_dir = argv[++i];
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch_manifest = argv[++i];
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            corpus_count = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            corpus_seed = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--max-len") == 0 && i + 1 < argc) {
+            corpus_max_len = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc) {
+            report_format = argv[++i];
         }
     }
 
+    ResourceSnapshot run_start = ResourceSnapshot::take();
+    auto report = [&](int status) {
+        if (!report_format.empty()) {
+            printResourceReport("total", run_start, ResourceSnapshot::take(), report_format == "json");
+        }
+        return status;
+    };
+
+    if (!corpus_dir.empty()) {
+        return report(build_corpus(corpus_dir, corpus_count, corpus_seed, corpus_max_len, threads, report_format));
+    }
+    if (!batch_manifest.empty()) {
+        return report(run_batch(batch_manifest, num_channels, threads, dither, report_format));
+    }
+
     if (msg.empty()) {
         std::cerr << "Error: Message (-m) is required." << std::endl;
         return 1;
@@ -146,6 +833,20 @@ int main(int argc, char* argv[]) {
         output_file = "sine_message_" + std::to_string(ext_total_duration) + ".wav";
     }
 
-    sine_gen(msg, bps, level_dbfs, sample_rate_khz, output_file);
-    return 0;
+    if (rates_khz.empty()) rates_khz.push_back(sample_rate_khz);
+    if (formats.empty()) formats.push_back(SampleFormat::Pcm16);
+    std::vector<OutputSpec> outputs;
+    std::filesystem::path stem(output_file);
+    for (double rate : rates_khz) {
+        for (SampleFormat format : formats) {
+            std::string path = output_file;
+            if (rates_khz.size() * formats.size() > 1) {
+                std::ostringstream name;
+                name << stem.stem().string() << '_' << rate << "k_" << sample_format_name(format) << ".wav";
+                path = (stem.parent_path() / name.str()).string();
+            }
+            outputs.push_back({path, rate, format});
+        }
+    }
+    return report(render_outputs(make_schedule(msg, bps), level_dbfs, num_channels, outputs, false, dither) ? 0 : 1);
 }
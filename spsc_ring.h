@@ -0,0 +1,180 @@
+/*
+Title: Lock-Free Single-Producer/Single-Consumer Ring Buffer
+Name: spsc_ring.h
+Author: Ishan Leung
+Language: C++23
+
+Notes:
+Header-only; carries small trivially copyable descriptors between pipeline stages running on
+separate threads, one pushing and one popping.
+- Producer and consumer indices sit on their own cache lines, and each side keeps a private copy
+  of the other's index so it only touches the shared line when the ring looks full or empty.
+- push() and pop() move batches, publishing once per batch.
+- A side that has to wait either busy-polls (lowest latency, burns its core; meant for stages
+  pinned to cores of their own) or spins briefly and then sleeps on a futex; the other side only
+  makes the wake-up syscall when someone is asleep.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+enum class RingWait { Spin, Futex };
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Sleep while `word` still holds `expected`; spurious returns are fine, callers re-check
+inline void futexWait(std::atomic<uint32_t>& word, uint32_t expected) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+inline void futexWakeAll(std::atomic<uint32_t>& word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+
+template <typename T>
+class SpscRing {
+    static_assert(std::is_trivially_copyable_v<T>, "ring slots are copied with plain stores");
+
+public:
+    static constexpr size_t kCacheLine = 64;
+
+    // `capacity` is rounded up to a power of two
+    SpscRing(size_t capacity, RingWait wait)
+        : capacity_(std::bit_ceil(std::max<size_t>(capacity, 2))),
+          mask_(static_cast<uint32_t>(capacity_ - 1)),
+          wait_(wait),
+          slots_(std::make_unique<T[]>(capacity_)) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    size_t capacity() const { return capacity_; }
+
+    // Producer: copy in as many of `items` as fit without waiting; returns how many
+    size_t tryPush(const T* items, size_t count) {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        size_t space = capacity_ - (head - cachedTail_);
+        if (space < count) {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            space = capacity_ - (head - cachedTail_);
+        }
+        size_t n = std::min(space, count);
+        for (size_t k = 0; k < n; ++k) slots_[(head + k) & mask_] = items[k];
+        if (n == 0) return 0;
+        head_.store(head + static_cast<uint32_t>(n), std::memory_order_release);
+        wakeIfAsleep(consumerAsleep_, head_);
+        return n;
+    }
+
+    // Producer: copy in all of `items`, waiting for space as needed
+    void push(const T* items, size_t count) {
+        for (size_t done = 0; done < count;) {
+            size_t n = tryPush(items + done, count - done);
+            done += n;
+            if (n > 0) continue;
+            waitFor(producerAsleep_, tail_, [&] {
+                return head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_acquire) < capacity_;
+            });
+        }
+    }
+
+    void push(const T& item) { push(&item, 1); }
+
+    // Producer: no more items; the consumer drains what is queued and then sees pop() return 0
+    void close() {
+        closed_.store(1, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (consumerAsleep_.load(std::memory_order_relaxed)) futexWakeAll(head_);
+    }
+
+    // Consumer: copy out up to `max` queued items without waiting; returns how many
+    size_t tryPop(T* out, size_t max) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        size_t queued = cachedHead_ - tail;
+        if (queued == 0) {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            queued = cachedHead_ - tail;
+        }
+        size_t n = std::min(queued, max);
+        for (size_t k = 0; k < n; ++k) out[k] = slots_[(tail + k) & mask_];
+        if (n == 0) return 0;
+        tail_.store(tail + static_cast<uint32_t>(n), std::memory_order_release);
+        wakeIfAsleep(producerAsleep_, tail_);
+        return n;
+    }
+
+    // Consumer: wait for at least one item and take up to `max`; 0 once closed and drained
+    size_t pop(T* out, size_t max) {
+        for (;;) {
+            if (size_t n = tryPop(out, max)) return n;
+            if (closed_.load(std::memory_order_acquire)) return tryPop(out, max);
+            waitFor(consumerAsleep_, head_, [&] {
+                return head_.load(std::memory_order_acquire) != tail_.load(std::memory_order_relaxed) ||
+                       closed_.load(std::memory_order_acquire);
+            });
+        }
+    }
+
+private:
+    static constexpr int kSpinsBeforeSleep = 2048;
+
+    // Spin until `ready()`. Past the spin budget RingWait::Spin keeps polling but yields between
+    // polls, so a stage sharing its core still lets the other side run; RingWait::Futex sleeps
+    // on `word` instead, advertising it in `asleep` so the other side knows to wake us.
+    template <typename Ready>
+    void waitFor(std::atomic<uint32_t>& asleep, std::atomic<uint32_t>& word, Ready ready) {
+        for (int spin = 0; spin < kSpinsBeforeSleep; ++spin) {
+            if (ready()) return;
+            cpuRelax();
+        }
+        if (wait_ == RingWait::Spin) {
+            while (!ready()) sched_yield();
+            return;
+        }
+        uint32_t seen = word.load(std::memory_order_relaxed);
+        asleep.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);  // Pairs with the fence in wakeIfAsleep
+        if (!ready()) futexWait(word, seen);
+        asleep.store(0, std::memory_order_relaxed);
+    }
+
+    void wakeIfAsleep(std::atomic<uint32_t>& asleep, std::atomic<uint32_t>& word) {
+        if (wait_ != RingWait::Futex) return;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (asleep.load(std::memory_order_relaxed)) futexWakeAll(word);
+    }
+
+    const size_t capacity_;
+    const uint32_t mask_;
+    const RingWait wait_;
+    std::unique_ptr<T[]> slots_;
+
+    alignas(kCacheLine) std::atomic<uint32_t> head_{0};  // Written by the producer
+    uint32_t cachedTail_ = 0;                            // Producer's last view of tail_
+
+    alignas(kCacheLine) std::atomic<uint32_t> tail_{0};  // Written by the consumer
+    uint32_t cachedHead_ = 0;                            // Consumer's last view of head_
+
+    // Rarely written: only around sleeps and at the end of the stream
+    alignas(kCacheLine) std::atomic<uint32_t> producerAsleep_{0};
+    std::atomic<uint32_t> consumerAsleep_{0};
+    std::atomic<uint32_t> closed_{0};
+};